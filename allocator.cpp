@@ -0,0 +1,319 @@
+#include <assert.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "lib/log.h"
+#include "allocator.h"
+
+// ----------------------------------------------------------------------------
+// STATIC DEFINITIONS
+// ----------------------------------------------------------------------------
+
+static const size_t ARENA_ALIGN = 16;
+
+static void *arena_alloc   (void *ctx, size_t size);
+static void *arena_realloc (void *ctx, void *ptr, size_t old_size, size_t new_size);
+static void  arena_free    (void *ctx, void *ptr, size_t size);
+
+static void *mmap_alloc    (void *ctx, size_t size);
+static void *mmap_realloc  (void *ctx, void *ptr, size_t old_size, size_t new_size);
+static void  mmap_free     (void *ctx, void *ptr, size_t size);
+
+static size_t page_round   (size_t size);
+static void   advise_huge  (void *ptr, size_t size);
+
+// ----------------------------------------------------------------------------
+// PUBLIC FUNCTIONS
+// ----------------------------------------------------------------------------
+
+void *list::allocate (const allocator_t *allocator, size_t size)
+{
+    if (allocator == nullptr)
+    {
+        return malloc (size);
+    }
+
+    return allocator->alloc (allocator->ctx, size);
+}
+
+void *list::reallocate (const allocator_t *allocator, void *ptr, size_t old_size, size_t new_size)
+{
+    if (allocator == nullptr)
+    {
+        return realloc (ptr, new_size);
+    }
+
+    return allocator->realloc (allocator->ctx, ptr, old_size, new_size);
+}
+
+void list::deallocate (const allocator_t *allocator, void *ptr, size_t size)
+{
+    if (allocator == nullptr)
+    {
+        free (ptr);
+        return;
+    }
+
+    if (ptr != nullptr)
+    {
+        allocator->free (allocator->ctx, ptr, size);
+    }
+}
+
+bool list::reallocate_arrays (const allocator_t *allocator, void **arrays, const size_t *elem_sizes,
+                              size_t n_arrays, size_t old_cells, size_t new_cells)
+{
+    assert (arrays     != nullptr && "pointer can't be nullptr");
+    assert (elem_sizes != nullptr && "pointer can't be nullptr");
+
+    size_t resized = 0;
+
+    for (; resized < n_arrays; ++resized)
+    {
+        void *tmp_ptr = list::reallocate (allocator, arrays[resized], old_cells * elem_sizes[resized],
+                                                                      new_cells * elem_sizes[resized]);
+        if (tmp_ptr == nullptr)
+        {
+            break;
+        }
+
+        arrays[resized] = tmp_ptr;
+    }
+
+    if (resized == n_arrays)
+    {
+        return true;
+    }
+
+    for (size_t i = 0; i < resized; ++i)
+    {
+        void *tmp_ptr = list::reallocate (allocator, arrays[i], new_cells * elem_sizes[i],
+                                                                old_cells * elem_sizes[i]);
+        if (tmp_ptr != nullptr)
+        {
+            arrays[i] = tmp_ptr;
+        }
+    }
+
+    log (log::ERR, "OOM");
+    return false;
+}
+
+// ----------------------------------------------------------------------------
+
+bool list::arena_ctor (arena_t *arena, size_t capacity)
+{
+    assert (arena != nullptr && "pointer can't be nullptr");
+
+    arena->buf      = (char *) malloc (capacity);
+    arena->capacity = (arena->buf != nullptr) ? capacity : 0;
+    arena->used     = 0;
+    arena->last     = 0;
+
+    if (arena->buf == nullptr)
+    {
+        log (log::ERR, "OOM");
+        return false;
+    }
+
+    return true;
+}
+
+void list::arena_dtor (arena_t *arena)
+{
+    assert (arena != nullptr && "pointer can't be nullptr");
+
+    free (arena->buf);
+
+    arena->buf      = nullptr;
+    arena->capacity = 0;
+    arena->used     = 0;
+    arena->last     = 0;
+}
+
+void list::arena_reset (arena_t *arena)
+{
+    assert (arena != nullptr && "pointer can't be nullptr");
+
+    arena->used = 0;
+    arena->last = 0;
+}
+
+list::allocator_t list::arena_allocator (arena_t *arena)
+{
+    assert (arena != nullptr && "pointer can't be nullptr");
+
+    return {arena, arena_alloc, arena_realloc, arena_free};
+}
+
+list::allocator_t list::mmap_allocator ()
+{
+    return {nullptr, mmap_alloc, mmap_realloc, mmap_free};
+}
+
+// ----------------------------------------------------------------------------
+// STATIC FUNCTIONS
+// ----------------------------------------------------------------------------
+
+static void *arena_alloc (void *ctx, size_t size)
+{
+    assert (ctx != nullptr && "pointer can't be nullptr");
+
+    list::arena_t *arena = (list::arena_t *) ctx;
+
+    size_t start = (arena->used + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    if (start > arena->capacity || size > arena->capacity - start)
+    {
+        log (log::ERR, "Arena is exhausted: %zu of %zu bytes used, %zu requested",
+                        arena->used, arena->capacity, size);
+        return nullptr;
+    }
+
+    arena->last = start;
+    arena->used = start + size;
+
+    return arena->buf + start;
+}
+
+static void *arena_realloc (void *ctx, void *ptr, size_t old_size, size_t new_size)
+{
+    assert (ctx != nullptr && "pointer can't be nullptr");
+
+    list::arena_t *arena = (list::arena_t *) ctx;
+
+    if (ptr == nullptr)
+    {
+        return arena_alloc (ctx, new_size);
+    }
+
+    // Last block grows and shrinks in place
+    if ((char *) ptr == arena->buf + arena->last && arena->last + old_size == arena->used)
+    {
+        if (new_size > arena->capacity - arena->last)
+        {
+            log (log::ERR, "Arena is exhausted: %zu of %zu bytes used, %zu requested",
+                            arena->used, arena->capacity, new_size);
+            return nullptr;
+        }
+
+        arena->used = arena->last + new_size;
+        return ptr;
+    }
+
+    if (new_size <= old_size)
+    {
+        return ptr;
+    }
+
+    void *new_ptr = arena_alloc (ctx, new_size);
+    if (new_ptr != nullptr)
+    {
+        memcpy (new_ptr, ptr, old_size);
+    }
+
+    return new_ptr;
+}
+
+static void arena_free (void *ctx, void *ptr, size_t size)
+{
+    assert (ctx != nullptr && "pointer can't be nullptr");
+
+    list::arena_t *arena = (list::arena_t *) ctx;
+
+    if ((char *) ptr == arena->buf + arena->last && arena->last + size == arena->used)
+    {
+        arena->used = arena->last;
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+static void *mmap_alloc (void *, size_t size)
+{
+    size_t len = page_round (size);
+
+    void *ptr = mmap (nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED)
+    {
+        log (log::ERR, "mmap of %zu bytes failed", len);
+        return nullptr;
+    }
+
+    advise_huge (ptr, len);
+
+    return ptr;
+}
+
+static void *mmap_realloc (void *ctx, void *ptr, size_t old_size, size_t new_size)
+{
+    if (ptr == nullptr)
+    {
+        return mmap_alloc (ctx, new_size);
+    }
+
+    size_t old_len = page_round (old_size);
+    size_t new_len = page_round (new_size);
+
+    if (old_len == new_len)
+    {
+        return ptr;
+    }
+
+#ifdef __linux__
+    void *new_ptr = mremap (ptr, old_len, new_len, MREMAP_MAYMOVE);
+    if (new_ptr == MAP_FAILED)
+    {
+        log (log::ERR, "mremap of %zu bytes failed", new_len);
+        return nullptr;
+    }
+
+    advise_huge (new_ptr, new_len);
+#else
+    void *new_ptr = mmap_alloc (ctx, new_size);
+    if (new_ptr == nullptr)
+    {
+        return nullptr;
+    }
+
+    memcpy (new_ptr, ptr, (old_size < new_size) ? old_size : new_size);
+    munmap (ptr, old_len);
+#endif
+
+    return new_ptr;
+}
+
+static void mmap_free (void *, void *ptr, size_t size)
+{
+    if (ptr != nullptr)
+    {
+        munmap (ptr, page_round (size));
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+static size_t page_round (size_t size)
+{
+    static const size_t page = (size_t) sysconf (_SC_PAGESIZE);
+
+    if (size == 0)
+    {
+        size = 1;
+    }
+
+    return (size + page - 1) / page * page;
+}
+
+static void advise_huge (void *ptr, size_t size)
+{
+#ifdef MADV_HUGEPAGE
+    if (size >= list::HUGE_PAGE_SIZE)
+    {
+        madvise (ptr, size, MADV_HUGEPAGE);
+    }
+#else
+    (void) ptr;
+    (void) size;
+#endif
+}
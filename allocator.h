@@ -0,0 +1,74 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <stdlib.h>
+
+// ----------------------------------------------------------------------------
+// Allocator hooks for list storage. Every call gets the context pointer and
+// the size of the block, so allocators don't have to keep block headers.
+// ----------------------------------------------------------------------------
+
+namespace list
+{
+    struct allocator_t
+    {
+        void *ctx;
+
+        void *(*alloc)   (void *ctx, size_t size);
+        void *(*realloc) (void *ctx, void *ptr, size_t old_size, size_t new_size);
+        void  (*free)    (void *ctx, void *ptr, size_t size);
+    };
+
+    // ------------------------------------------------------------------------
+    // Calls through allocator, libc heap is used when allocator == nullptr.
+    // Everything a list owns goes through them, so arena_reset releases it all
+    // ------------------------------------------------------------------------
+
+    void *allocate   (const allocator_t *allocator, size_t size);
+    void *reallocate (const allocator_t *allocator, void *ptr, size_t old_size, size_t new_size);
+    void  deallocate (const allocator_t *allocator, void *ptr, size_t size);
+
+    /**
+     * @brief Resizes n_arrays parallel arrays from old_cells to new_cells elements.
+     *        When one of them fails, the ones already resized are restored, so
+     *        all arrays keep old_cells elements and the sizes passed to free stay right
+     *
+     * @return false on failure
+     */
+    [[nodiscard]]
+    bool reallocate_arrays (const allocator_t *allocator, void **arrays, const size_t *elem_sizes,
+                            size_t n_arrays, size_t old_cells, size_t new_cells);
+
+    // ------------------------------------------------------------------------
+    // Bump arena: one malloc'ed block, freeing is a no-op except for the last
+    // allocation, everything is released at once by arena_dtor/arena_reset
+    // ------------------------------------------------------------------------
+
+    struct arena_t
+    {
+        char   *buf;
+        size_t  capacity;
+        size_t  used;
+        size_t  last;
+    };
+
+    [[nodiscard]]
+    bool arena_ctor  (arena_t *arena, size_t capacity);
+    void arena_dtor  (arena_t *arena);
+    void arena_reset (arena_t *arena);
+
+    /**
+     * @brief Allocator that takes memory from arena, arena must outlive the lists
+     */
+    allocator_t arena_allocator (arena_t *arena);
+
+    /**
+     * @brief Allocator that maps every array separately, arrays of at least
+     *        HUGE_PAGE_SIZE bytes are advised to use transparent huge pages
+     */
+    allocator_t mmap_allocator ();
+
+    const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+}
+
+#endif //ALLOCATOR_H
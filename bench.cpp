@@ -0,0 +1,632 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <deque>
+#include <list>
+#include <thread>
+#include <vector>
+
+#include "lib/log.h"
+#include "list.h"
+#include "list_iterator.h"
+#include "queue_list.h"
+#include "search.h"
+
+// ----------------------------------------------------------------------------
+// Microbenchmarks for list operations vs std containers.
+// Usage: list_bench [max_size], prints JSON to stdout.
+// ----------------------------------------------------------------------------
+
+// Operations with O(n) cost per call are capped, so large sizes stay tractable
+static const size_t MAX_OPS      = 10000;
+static const size_t WALK_BUDGET  = 100000000;
+static const size_t DEFAULT_MAX  = 1000000;
+
+typedef std::chrono::steady_clock bench_clock;
+
+static bool first_result = true;
+
+// Results are folded in and printed, so the compiler can't drop the work
+static size_t sink = 0;
+
+static void report (const char *op, const char *container, size_t size, size_t ops,
+                    bench_clock::time_point start);
+
+static void bench_list     (size_t size);
+static void bench_walk     (size_t size);
+static void bench_std_list (size_t size);
+static void bench_deque    (size_t size);
+static void bench_vector   (size_t size);
+static void bench_queue    (size_t size);
+static void bench_sort_by  (size_t size);
+
+static void     print_int     (void *elem, FILE *stream);
+static void     fill_shuffled (list::list_t *list, size_t size);
+static int      cmp_int       (const void *a, const void *b);
+static uint64_t int_key       (const void *elem);
+static size_t   rand_below    (size_t bound);
+static size_t   walk_ops      (size_t size);
+
+// ----------------------------------------------------------------------------
+
+int main (int argc, char *argv[])
+{
+    set_log_level  (log::ERR);
+    set_log_stream (stderr);
+
+    size_t max_size = (argc > 1) ? strtoull (argv[1], nullptr, 10) : DEFAULT_MAX;
+
+    srand (42);
+
+    printf ("{\n  \"max_size\": %zu,\n  \"results\": [\n", max_size);
+
+    for (size_t size = 100; size <= max_size; size *= 10)
+    {
+        bench_list     (size);
+        bench_walk     (size);
+        bench_sort_by  (size);
+        bench_std_list (size);
+        bench_deque    (size);
+        bench_vector   (size);
+        bench_queue    (size);
+
+        fflush (stdout);
+    }
+
+    printf ("\n  ],\n  \"sink\": %zu\n}\n", sink);
+
+    return 0;
+}
+
+// ----------------------------------------------------------------------------
+
+static void bench_list (size_t size)
+{
+    list::list_t list;
+    int val = 0;
+
+    // push_back / pop_back
+    list::ctor (&list, sizeof (int), 0, print_int);
+
+    auto start = bench_clock::now ();
+    for (size_t i = 0; i < size; ++i)
+    {
+        val = (int) i;
+        list::push_back (&list, &val);
+    }
+    report ("push_back", "list", size, size, start);
+
+    start = bench_clock::now ();
+    sink += list::verify (&list);
+    report ("verify", "list", size, 1, start);
+
+    start = bench_clock::now ();
+    for (size_t i = list::head (&list); i != 0; i = list::next (&list, i))
+    {
+        sink += i;
+    }
+    report ("walk_next", "list", size, size, start);
+
+    start = bench_clock::now ();
+    for (int elem : list::view<int> (&list))
+    {
+        sink += (size_t) elem;
+    }
+    report ("walk_iterator", "list", size, size, start);
+
+    size_t queries = walk_ops (size);
+    start = bench_clock::now ();
+    for (size_t i = 0; i < queries; ++i)
+    {
+        sink += list::get_iter (&list, rand_below (size));
+    }
+    report ("get_iter_sorted", "list", size, queries, start);
+
+    start = bench_clock::now ();
+    list::resize (&list, list.capacity * 2);
+    report ("resize", "list", size, 1, start);
+
+    start = bench_clock::now ();
+    for (size_t i = 0; i < size; ++i)
+    {
+        list::pop_back (&list, &val);
+    }
+    report ("pop_back", "list", size, size, start);
+
+    list::dtor (&list);
+
+    // push_front / pop_front, push_front leaves storage in reversed order
+    list::ctor (&list, sizeof (int), 0, print_int);
+
+    start = bench_clock::now ();
+    for (size_t i = 0; i < size; ++i)
+    {
+        val = (int) i;
+        list::push_front (&list, &val);
+    }
+    report ("push_front", "list", size, size, start);
+
+    start = bench_clock::now ();
+    for (size_t i = 0; i < queries; ++i)
+    {
+        sink += list::get_iter (&list, rand_below (size));
+    }
+    report ("get_iter_unsorted", "list", size, queries, start);
+
+    size_t ops = (size < MAX_OPS) ? size : MAX_OPS;
+
+    list::enable_order_index (&list);
+    start = bench_clock::now ();
+    for (size_t i = 0; i < ops; ++i)
+    {
+        sink += list::get_iter (&list, rand_below (size));
+    }
+    report ("get_iter_indexed", "list", size, ops, start);
+    list::disable_order_index (&list);
+
+    // Cells 1..size are all live, so random cell is random position
+    start = bench_clock::now ();
+    for (size_t i = 0; i < ops; ++i)
+    {
+        val = (int) i;
+        list::insert_after (&list, 1 + rand_below (size), &val);
+    }
+    report ("insert_after_random", "list", size, ops, start);
+
+    start = bench_clock::now ();
+    list::sort (&list);
+    report ("sort", "list", size + ops, 1, start);
+
+    list::push_front (&list, &val);
+
+    start = bench_clock::now ();
+    list::sort (&list, true);
+    report ("sort_copy", "list", size + 1, 1, start);
+
+    start = bench_clock::now ();
+    for (size_t i = 0; i < size; ++i)
+    {
+        list::pop_front (&list, &val);
+    }
+    report ("pop_front", "list", size, size, start);
+
+    list::dtor (&list);
+}
+
+// ----------------------------------------------------------------------------
+
+// Traversal of a list whose logical order is a random permutation of cells
+static void bench_walk (size_t size)
+{
+    list::list_t list;
+    int val = 0;
+
+    list::ctor (&list, sizeof (int), size, print_int);
+    fill_shuffled (&list, size);
+
+    auto start = bench_clock::now ();
+    for (size_t i = list::head (&list); i != 0; i = list::next (&list, i))
+    {
+        list::get (&list, i, &val);
+        sink += (size_t) val;
+    }
+    report ("walk_next_shuffled", "list", size, size, start);
+
+    start = bench_clock::now ();
+    for (int elem : list::view<int> (&list))
+    {
+        sink += (size_t) elem;
+    }
+    report ("walk_iterator_shuffled", "list", size, size, start);
+
+    start = bench_clock::now ();
+    list::for_each<int> (&list, [] (int elem) { sink += (size_t) elem; });
+    report ("for_each_shuffled", "list", size, size, start);
+
+    // Value that isn't there, so every search scans the whole list
+    int missing = -1;
+
+    start = bench_clock::now ();
+    for (size_t i = list::head (&list); i != 0; i = list::next (&list, i))
+    {
+        list::get (&list, i, &val);
+        if (val == missing)
+        {
+            break;
+        }
+    }
+    report ("find_walk_shuffled", "list", size, size, start);
+
+    start = bench_clock::now ();
+    sink += (size_t) list::find (&list, &missing);
+    report ("find_shuffled", "list", size, size, start);
+
+    list::sort (&list);
+
+    start = bench_clock::now ();
+    list::for_each<int> (&list, [] (int elem) { sink += (size_t) elem; });
+    report ("for_each_sorted", "list", size, size, start);
+
+    start = bench_clock::now ();
+    sink += (size_t) list::find (&list, &missing);
+    report ("find_sorted", "list", size, size, start);
+
+    start = bench_clock::now ();
+    sink += list::count (&list, &missing);
+    report ("count_sorted", "list", size, size, start);
+
+    // FIFO churn with spare capacity: appends go right after the tail, not
+    // into the freed front cells, so the list stays linear
+    list::resize (&list, size * 2);
+    size_t ops = (size < MAX_OPS) ? size : MAX_OPS;
+
+    start = bench_clock::now ();
+    for (size_t i = 0; i < ops; ++i)
+    {
+        list::pop_front (&list, &val);
+        list::push_back (&list, &val);
+    }
+    report ("fifo_churn", "list", size, ops, start);
+
+    size_t queries = walk_ops (size);
+    start = bench_clock::now ();
+    for (size_t i = 0; i < queries; ++i)
+    {
+        sink += list::get_iter (&list, rand_below (size));
+    }
+    report ("get_iter_after_churn", "list", size, queries, start);
+
+    list::dtor (&list);
+}
+
+// ----------------------------------------------------------------------------
+
+// Value order is random, std::list::sort is the baseline
+static void bench_sort_by (size_t size)
+{
+    list::list_t list;
+
+    list::ctor (&list, sizeof (int), size, print_int);
+    fill_shuffled (&list, size);
+
+    auto start = bench_clock::now ();
+    list::sort_by (&list, cmp_int);
+    report ("sort_by", "list", size, 1, start);
+
+    list::dtor (&list);
+
+    list::ctor (&list, sizeof (int), size, print_int);
+    fill_shuffled (&list, size);
+
+    start = bench_clock::now ();
+    list::sort_by_key (&list, int_key);
+    report ("sort_by_key", "list", size, 1, start);
+
+    start = bench_clock::now ();
+    list::sort (&list);
+    report ("sort_after_sort_by", "list", size, 1, start);
+
+    list::dtor (&list);
+
+    // Linearisation of a fragmented list: serial copy vs parallel ranking
+    list::ctor (&list, sizeof (int), size, print_int);
+    fill_shuffled (&list, size);
+
+    start = bench_clock::now ();
+    list::sort (&list, true);
+    report ("sort_copy_shuffled", "list", size, 1, start);
+
+    list::dtor (&list);
+
+    list::ctor (&list, sizeof (int), size, print_int);
+    fill_shuffled (&list, size);
+
+    start = bench_clock::now ();
+    list::sort_parallel (&list);
+    report ("sort_parallel_shuffled", "list", size, 1, start);
+
+    list::dtor (&list);
+
+    std::list<int> std_list;
+    for (size_t i = 0; i < size; ++i)
+    {
+        std_list.push_back ((int) rand_below (size));
+    }
+
+    start = bench_clock::now ();
+    std_list.sort ();
+    report ("sort_by", "std::list", size, 1, start);
+}
+
+// ----------------------------------------------------------------------------
+
+static void bench_std_list (size_t size)
+{
+    std::list<int> list;
+
+    auto start = bench_clock::now ();
+    for (size_t i = 0; i < size; ++i)
+    {
+        list.push_back ((int) i);
+    }
+    report ("push_back", "std::list", size, size, start);
+
+    size_t queries = walk_ops (size);
+    start = bench_clock::now ();
+    for (size_t i = 0; i < queries; ++i)
+    {
+        sink += (size_t) *std::next (list.begin (), (long) rand_below (size));
+    }
+    report ("get_iter_sorted", "std::list", size, queries, start);
+
+    start = bench_clock::now ();
+    for (size_t i = 0; i < size; ++i)
+    {
+        list.pop_back ();
+    }
+    report ("pop_back", "std::list", size, size, start);
+
+    start = bench_clock::now ();
+    for (size_t i = 0; i < size; ++i)
+    {
+        list.push_front ((int) i);
+    }
+    report ("push_front", "std::list", size, size, start);
+
+    // Iterators are held the same way as list cell indexes
+    std::vector<std::list<int>::iterator> iters;
+    iters.reserve (size);
+    for (auto it = list.begin (); it != list.end (); ++it)
+    {
+        iters.push_back (it);
+    }
+
+    size_t ops = (size < MAX_OPS) ? size : MAX_OPS;
+    start = bench_clock::now ();
+    for (size_t i = 0; i < ops; ++i)
+    {
+        list.insert (std::next (iters[rand_below (size)]), (int) i);
+    }
+    report ("insert_after_random", "std::list", size, ops, start);
+
+    start = bench_clock::now ();
+    size_t total = list.size ();
+    for (size_t i = 0; i < total; ++i)
+    {
+        list.pop_front ();
+    }
+    report ("pop_front", "std::list", size, total, start);
+}
+
+// ----------------------------------------------------------------------------
+
+static void bench_deque (size_t size)
+{
+    std::deque<int> deque;
+
+    auto start = bench_clock::now ();
+    for (size_t i = 0; i < size; ++i)
+    {
+        deque.push_back ((int) i);
+    }
+    report ("push_back", "std::deque", size, size, start);
+
+    size_t ops = (size < MAX_OPS) ? size : MAX_OPS;
+    start = bench_clock::now ();
+    for (size_t i = 0; i < ops; ++i)
+    {
+        sink += (size_t) deque[rand_below (size)];
+    }
+    report ("get_iter_sorted", "std::deque", size, ops, start);
+
+    size_t inserts = (walk_ops (size) < ops) ? walk_ops (size) : ops;
+    start = bench_clock::now ();
+    for (size_t i = 0; i < inserts; ++i)
+    {
+        deque.insert (deque.begin () + (long) rand_below (size) + 1, (int) i);
+    }
+    report ("insert_after_random", "std::deque", size, inserts, start);
+    deque.resize (size);
+
+    start = bench_clock::now ();
+    for (size_t i = 0; i < size; ++i)
+    {
+        deque.pop_back ();
+    }
+    report ("pop_back", "std::deque", size, size, start);
+
+    start = bench_clock::now ();
+    for (size_t i = 0; i < size; ++i)
+    {
+        deque.push_front ((int) i);
+    }
+    report ("push_front", "std::deque", size, size, start);
+
+    start = bench_clock::now ();
+    for (size_t i = 0; i < size; ++i)
+    {
+        deque.pop_front ();
+    }
+    report ("pop_front", "std::deque", size, size, start);
+}
+
+// ----------------------------------------------------------------------------
+
+static void bench_vector (size_t size)
+{
+    std::vector<int> vector;
+
+    auto start = bench_clock::now ();
+    for (size_t i = 0; i < size; ++i)
+    {
+        vector.push_back ((int) i);
+    }
+    report ("push_back", "std::vector", size, size, start);
+
+    size_t ops = (size < MAX_OPS) ? size : MAX_OPS;
+    start = bench_clock::now ();
+    for (size_t i = 0; i < ops; ++i)
+    {
+        sink += (size_t) vector[rand_below (size)];
+    }
+    report ("get_iter_sorted", "std::vector", size, ops, start);
+
+    size_t inserts = (walk_ops (size) < ops) ? walk_ops (size) : ops;
+    start = bench_clock::now ();
+    for (size_t i = 0; i < inserts; ++i)
+    {
+        vector.insert (vector.begin () + (long) rand_below (size) + 1, (int) i);
+    }
+    report ("insert_after_random", "std::vector", size, inserts, start);
+    vector.resize (size);
+
+    start = bench_clock::now ();
+    vector.reserve (vector.capacity () * 2);
+    report ("resize", "std::vector", size, 1, start);
+
+    start = bench_clock::now ();
+    for (size_t i = 0; i < size; ++i)
+    {
+        vector.pop_back ();
+    }
+    report ("pop_back", "std::vector", size, size, start);
+}
+
+// ----------------------------------------------------------------------------
+
+// Producer threads against one consumer, QUEUE_SLOTS cells of storage
+static const size_t QUEUE_SLOTS = 4096;
+static const size_t QUEUE_BATCH = 64;
+
+static void bench_queue (size_t size)
+{
+    list::list_t  list;
+    list::queue_t queue;
+
+    list::ctor (&list, sizeof (int), QUEUE_SLOTS, print_int);
+    list::queue::attach (&queue, &list, list::QUEUE_SPSC);
+
+    int batch[QUEUE_BATCH] = {};
+
+    auto start = bench_clock::now ();
+    std::thread producer ([&queue, size]
+    {
+        int elems[QUEUE_BATCH] = {};
+        for (size_t i = 0; i < size; )
+        {
+            size_t n = (size - i < QUEUE_BATCH) ? size - i : QUEUE_BATCH;
+            size_t pushed = list::queue::push_n (&queue, elems, n);
+
+            // Full queue: let consumer run, matters when cores are few
+            if (pushed == 0) std::this_thread::yield ();
+            i += pushed;
+        }
+    });
+
+    for (size_t i = 0; i < size; )
+    {
+        size_t popped = list::queue::pop_n (&queue, batch, QUEUE_BATCH);
+        if (popped == 0) std::this_thread::yield ();
+        i += popped;
+    }
+    producer.join ();
+    report ("queue_spsc_batch", "list", size, size, start);
+
+    list::queue::detach (&queue);
+    list::queue::attach (&queue, &list, list::QUEUE_MPSC);
+
+    // Two producers, one element per push
+    start = bench_clock::now ();
+    std::thread producers[2];
+    for (std::thread &thread : producers)
+    {
+        thread = std::thread ([&queue, size]
+        {
+            int elem = 0;
+            for (size_t i = 0; i < size / 2; )
+            {
+                if (list::queue::push (&queue, &elem)) i++;
+                else                                   std::this_thread::yield ();
+            }
+        });
+    }
+
+    for (size_t i = 0; i < size / 2 * 2; )
+    {
+        size_t popped = list::queue::pop_n (&queue, batch, QUEUE_BATCH);
+        if (popped == 0) std::this_thread::yield ();
+        i += popped;
+    }
+    for (std::thread &thread : producers)
+    {
+        thread.join ();
+    }
+    report ("queue_mpsc", "list", size, size / 2 * 2, start);
+
+    list::queue::detach (&queue);
+    list::dtor (&list);
+}
+
+// ----------------------------------------------------------------------------
+
+static void report (const char *op, const char *container, size_t size, size_t ops,
+                    bench_clock::time_point start)
+{
+    double ns = (double) std::chrono::duration_cast<std::chrono::nanoseconds>
+                            (bench_clock::now () - start).count ();
+
+    printf ("%s    {\"op\": \"%s\", \"container\": \"%s\", \"size\": %zu, \"ops\": %zu, "
+            "\"total_ns\": %.0f, \"ns_per_op\": %.2f}",
+            first_result ? "" : ",\n", op, container, size, ops, ns, (ops > 0) ? ns / (double) ops : 0.0);
+
+    first_result = false;
+}
+
+// Element i goes after a random earlier cell, so both value and storage
+// order differ from list order
+static void fill_shuffled (list::list_t *list, size_t size)
+{
+    int val = 0;
+
+    list::push_back (list, &val);
+    for (size_t i = 1; i < size; ++i)
+    {
+        val = (int) i;
+        list::insert_after (list, 1 + rand_below (i), &val);
+    }
+}
+
+static int cmp_int (const void *a, const void *b)
+{
+    int lhs = *(const int *) a;
+    int rhs = *(const int *) b;
+
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+static uint64_t int_key (const void *elem)
+{
+    return (uint32_t) *(const int *) elem ^ 0x80000000u;
+}
+
+static void print_int (void *elem, FILE *stream)
+{
+    fprintf (stream, "%d", *(int *) elem);
+}
+
+static size_t rand_below (size_t bound)
+{
+    size_t r = ((size_t) rand () << 31) ^ (size_t) rand ();
+    return r % bound;
+}
+
+// Number of O(n) walks that fit into WALK_BUDGET steps
+static size_t walk_ops (size_t size)
+{
+    size_t ops = WALK_BUDGET / size;
+
+    if (ops > MAX_OPS) return MAX_OPS;
+    if (ops == 0)      return 1;
+
+    return ops;
+}
@@ -0,0 +1,621 @@
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+#include <new>
+#include <thread>
+
+#include "lib/log.h"
+#include "concurrent_list.h"
+
+// ----------------------------------------------------------------------------
+// STATIC DEFINITIONS
+// ----------------------------------------------------------------------------
+
+static const uint64_t INDEX_BITS = 32;
+static const uint64_t INDEX_PART = ((uint64_t) 1 << INDEX_BITS) - 1;
+
+static size_t chunk_of     (size_t index);
+static size_t chunk_start  (size_t chunk);
+static size_t chunk_cells  (size_t chunk);
+
+static list::conc::cell_t *cell_at (list::conc_list_t *list, size_t index);
+static char               *data_at (list::conc_list_t *list, size_t index);
+
+static void lock_cell     (list::conc::cell_t *cell);
+static bool try_lock_cell (list::conc::cell_t *cell);
+static void unlock_cell   (list::conc::cell_t *cell);
+
+static bool link_cell (list::conc_list_t *list, size_t index, size_t new_index, bool tail_only);
+
+static size_t      pop_free  (list::conc_list_t *list);
+static void        push_free (list::conc_list_t *list, size_t first, size_t last);
+static list::err_t grow      (list::conc_list_t *list);
+static list::err_t add_chunk (list::conc_list_t *list);
+
+// ----------------------------------------------------------------------------
+// PUBLIC FUNCTIONS
+// ----------------------------------------------------------------------------
+
+list::err_t list::conc::ctor (conc_list_t *list, size_t obj_size, size_t reserved)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+    assert (obj_size > 0 && "Object size can't be less than 1");
+
+    for (size_t i = 0; i < MAX_CHUNKS; ++i)
+    {
+        list->chunks[i].store (nullptr, std::memory_order_relaxed);
+    }
+
+    list->n_chunks.store  (0, std::memory_order_relaxed);
+    list->free_head.store (0, std::memory_order_relaxed);
+    list->size.store      (0, std::memory_order_relaxed);
+    list->capacity.store  (0, std::memory_order_relaxed);
+    list->obj_size = obj_size;
+
+    // Chunk 0 holds null cell, so there is always at least one
+    do
+    {
+        err_t res = add_chunk (list);
+        if (res != list::OK)
+        {
+            list::conc::dtor (list);
+            return res;
+        }
+    }
+    while (list->capacity.load (std::memory_order_relaxed) < reserved);
+
+    return list::OK;
+}
+
+// ----------------------------------------------------------------------------
+
+void list::conc::dtor (conc_list_t *list)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+
+    for (size_t i = 0; i < MAX_CHUNKS; ++i)
+    {
+        chunk_t *chunk = list->chunks[i].load (std::memory_order_relaxed);
+        if (chunk == nullptr)
+        {
+            continue;
+        }
+
+        delete[] chunk->cells;
+        free (chunk->data);
+        free (chunk);
+
+        list->chunks[i].store (nullptr, std::memory_order_relaxed);
+    }
+
+    list->n_chunks.store  (0, std::memory_order_relaxed);
+    list->free_head.store (0, std::memory_order_relaxed);
+    list->size.store      (0, std::memory_order_relaxed);
+    list->capacity.store  (0, std::memory_order_relaxed);
+}
+
+// ----------------------------------------------------------------------------
+
+list::err_flags list::conc::verify (conc_list_t *list)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+
+    err_flags res      = list::OK;
+    size_t    capacity = list->capacity.load ();
+    size_t    size     = list->size.load ();
+
+    if (size > capacity)
+    {
+        res |= list::INVALID_SIZE;
+    }
+
+    size_t counter = 0;
+    size_t index   = 0;
+    do
+    {
+        cell_t *cell = cell_at (list, index);
+        size_t  next = cell->next.load ();
+
+        if (next > capacity || cell_at (list, next)->prev.load () != index ||
+            (index != 0 && !cell->live.load ()))
+        {
+            res |= list::BROKEN_DATA_LOOP;
+            break;
+        }
+
+        index = next;
+        counter++;
+    }
+    while (index != 0 && counter <= capacity);
+
+    if (counter != size + 1)
+    {
+        res |= list::BROKEN_DATA_LOOP;
+    }
+
+    size_t free_cnt = 0;
+    for (size_t i = list->free_head.load () & INDEX_PART; i != 0 && free_cnt <= capacity;
+         i = cell_at (list, i)->free_next.load ())
+    {
+        if (i > capacity || cell_at (list, i)->live.load ())
+        {
+            res |= list::BROKEN_FREE_LOOP;
+            break;
+        }
+
+        free_cnt++;
+    }
+
+    if (size + free_cnt != capacity)
+    {
+        res |= list::BROKEN_FREE_LOOP;
+    }
+
+    return res;
+}
+
+// ----------------------------------------------------------------------------
+
+ssize_t list::conc::insert_after (conc_list_t *list, size_t index, const void *elem)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+    assert (elem != nullptr && "pointer can't be nullptr");
+    assert (index <= list->capacity.load (std::memory_order_relaxed) && "index out of range");
+
+    size_t new_index = pop_free (list);
+    if (new_index == 0)
+    {
+        return -1;
+    }
+
+    memcpy (data_at (list, new_index), elem, list->obj_size);
+
+    if (!link_cell (list, index, new_index, false))
+    {
+        push_free (list, new_index, new_index);
+        return -1;
+    }
+
+    list->size.fetch_add (1, std::memory_order_relaxed);
+
+    return (ssize_t) new_index;
+}
+
+ssize_t list::conc::push_back (conc_list_t *list, const void *elem)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+    assert (elem != nullptr && "pointer can't be nullptr");
+
+    size_t new_index = pop_free (list);
+    if (new_index == 0)
+    {
+        return -1;
+    }
+
+    memcpy (data_at (list, new_index), elem, list->obj_size);
+
+    // Tail may be removed or appended to before it is locked, then re-read it
+    while (!link_cell (list, list::conc::tail (list), new_index, true))
+    {
+        std::this_thread::yield ();
+    }
+
+    list->size.fetch_add (1, std::memory_order_relaxed);
+
+    return (ssize_t) new_index;
+}
+
+ssize_t list::conc::push_front (conc_list_t *list, const void *elem)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+
+    return list::conc::insert_after (list, 0, elem);
+}
+
+// ----------------------------------------------------------------------------
+
+list::err_t list::conc::remove (conc_list_t *list, size_t index, void *elem)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+    assert (index <= list->capacity.load (std::memory_order_relaxed) && "index out of range");
+
+    if (index == 0)
+    {
+        return list::EMPTY;
+    }
+
+    cell_t *cell = cell_at (list, index);
+
+    while (true)
+    {
+        if (!cell->live.load (std::memory_order_acquire))
+        {
+            return list::EMPTY;
+        }
+
+        size_t  prev      = cell->prev.load (std::memory_order_acquire);
+        cell_t *prev_cell = cell_at (list, prev);
+
+        lock_cell (prev_cell);
+
+        // prev link is only trusted once prev cell is locked and still points here
+        if (prev_cell->next.load (std::memory_order_relaxed) != index)
+        {
+            unlock_cell (prev_cell);
+            continue;
+        }
+
+        if (!try_lock_cell (cell))
+        {
+            unlock_cell (prev_cell);
+            std::this_thread::yield ();
+            continue;
+        }
+
+        // Removed prev keeps its stale next, so both cells must be live and
+        // linked both ways while locked. Gone cell means a concurrent remove won.
+        bool prev_live = prev == 0 || prev_cell->live.load (std::memory_order_relaxed);
+        bool linked    = cell->prev.load (std::memory_order_relaxed) == prev;
+
+        if (!cell->live.load (std::memory_order_relaxed) || !prev_live || !linked)
+        {
+            unlock_cell (cell);
+            unlock_cell (prev_cell);
+            continue;
+        }
+
+        size_t  next      = cell->next.load (std::memory_order_relaxed);
+        cell_t *next_cell = cell_at (list, next);
+
+        if (next_cell != prev_cell && !try_lock_cell (next_cell))
+        {
+            unlock_cell (cell);
+            unlock_cell (prev_cell);
+            std::this_thread::yield ();
+            continue;
+        }
+
+        if (elem != nullptr)
+        {
+            memcpy (elem, data_at (list, index), list->obj_size);
+        }
+
+        prev_cell->next.store (uint32_t (next), std::memory_order_release);
+        next_cell->prev.store (uint32_t (prev), std::memory_order_release);
+        cell->live.store (false, std::memory_order_release);
+
+        if (next_cell != prev_cell)
+        {
+            unlock_cell (next_cell);
+        }
+        unlock_cell (cell);
+        unlock_cell (prev_cell);
+
+        break;
+    }
+
+    list->size.fetch_sub (1, std::memory_order_relaxed);
+    push_free (list, index, index);
+
+    return list::OK;
+}
+
+list::err_t list::conc::pop_front (conc_list_t *list, void *elem)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+
+    while (true)
+    {
+        size_t index = list::conc::head (list);
+        if (index == 0)
+        {
+            return list::EMPTY;
+        }
+
+        // Lost the race for this cell, try new head
+        if (list::conc::remove (list, index, elem) == list::OK)
+        {
+            return list::OK;
+        }
+    }
+}
+
+list::err_t list::conc::pop_back (conc_list_t *list, void *elem)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+
+    while (true)
+    {
+        size_t index = list::conc::tail (list);
+        if (index == 0)
+        {
+            return list::EMPTY;
+        }
+
+        if (list::conc::remove (list, index, elem) == list::OK)
+        {
+            return list::OK;
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+bool list::conc::get (conc_list_t *list, size_t index, void *elem)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+    assert (elem != nullptr && "pointer can't be nullptr");
+    assert (index <= list->capacity.load (std::memory_order_relaxed) && "index out of range");
+
+    cell_t *cell = cell_at (list, index);
+
+    lock_cell (cell);
+
+    bool live = index != 0 && cell->live.load (std::memory_order_acquire);
+    if (live)
+    {
+        memcpy (elem, data_at (list, index), list->obj_size);
+    }
+
+    unlock_cell (cell);
+
+    return live;
+}
+
+size_t list::conc::next (conc_list_t *list, size_t index)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+
+    return cell_at (list, index)->next.load (std::memory_order_acquire);
+}
+
+size_t list::conc::prev (conc_list_t *list, size_t index)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+
+    return cell_at (list, index)->prev.load (std::memory_order_acquire);
+}
+
+size_t list::conc::head (conc_list_t *list)
+{
+    return list::conc::next (list, 0);
+}
+
+size_t list::conc::tail (conc_list_t *list)
+{
+    return list::conc::prev (list, 0);
+}
+
+// ----------------------------------------------------------------------------
+// STATIC FUNCTIONS
+// ----------------------------------------------------------------------------
+
+// Chunk k holds CHUNK_BASE << k cells starting at CHUNK_BASE * (2^k - 1)
+static size_t chunk_of (size_t index)
+{
+    size_t blocks = index / list::conc::CHUNK_BASE + 1;
+
+    return (size_t) (63 - __builtin_clzll (blocks));
+}
+
+static size_t chunk_start (size_t chunk)
+{
+    return list::conc::CHUNK_BASE * (((size_t) 1 << chunk) - 1);
+}
+
+static size_t chunk_cells (size_t chunk)
+{
+    return list::conc::CHUNK_BASE << chunk;
+}
+
+static list::conc::cell_t *cell_at (list::conc_list_t *list, size_t index)
+{
+    size_t chunk = chunk_of (index);
+
+    return &list->chunks[chunk].load (std::memory_order_acquire)->cells[index - chunk_start (chunk)];
+}
+
+static char *data_at (list::conc_list_t *list, size_t index)
+{
+    size_t chunk = chunk_of (index);
+
+    return list->chunks[chunk].load (std::memory_order_acquire)->data +
+           (index - chunk_start (chunk)) * list->obj_size;
+}
+
+// ----------------------------------------------------------------------------
+
+// Links new_index after index, false if index is not in the list anymore
+// (or, with tail_only, is not the tail anymore)
+static bool link_cell (list::conc_list_t *list, size_t index, size_t new_index, bool tail_only)
+{
+    list::conc::cell_t *cell     = cell_at (list, index);
+    list::conc::cell_t *new_cell = cell_at (list, new_index);
+
+    while (true)
+    {
+        lock_cell (cell);
+
+        // next can't change while cell is locked, but prev of next can
+        size_t next = cell->next.load (std::memory_order_relaxed);
+
+        if ((index != 0 && !cell->live.load (std::memory_order_relaxed)) || (tail_only && next != 0))
+        {
+            unlock_cell (cell);
+            return false;
+        }
+
+        list::conc::cell_t *next_cell = cell_at (list, next);
+
+        if (next_cell != cell && !try_lock_cell (next_cell))
+        {
+            unlock_cell (cell);
+            std::this_thread::yield ();
+            continue;
+        }
+
+        new_cell->prev.store (uint32_t (index), std::memory_order_relaxed);
+        new_cell->next.store (uint32_t (next),  std::memory_order_relaxed);
+        new_cell->live.store (true,             std::memory_order_release);
+
+        // Release publishes payload and links of new cell to walkers
+        cell     ->next.store (uint32_t (new_index), std::memory_order_release);
+        next_cell->prev.store (uint32_t (new_index), std::memory_order_release);
+
+        if (next_cell != cell)
+        {
+            unlock_cell (next_cell);
+        }
+        unlock_cell (cell);
+
+        return true;
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+static void lock_cell (list::conc::cell_t *cell)
+{
+    while (!try_lock_cell (cell))
+    {
+        while (cell->lock.load (std::memory_order_relaxed))
+        {
+            std::this_thread::yield ();
+        }
+    }
+}
+
+static bool try_lock_cell (list::conc::cell_t *cell)
+{
+    return !cell->lock.exchange (true, std::memory_order_acquire);
+}
+
+static void unlock_cell (list::conc::cell_t *cell)
+{
+    cell->lock.store (false, std::memory_order_release);
+}
+
+// ----------------------------------------------------------------------------
+
+// Treiber stack pop, tag in the high half makes a stale CAS fail after ABA.
+// Returns 0 if list can't grow.
+static size_t pop_free (list::conc_list_t *list)
+{
+    uint64_t head = list->free_head.load (std::memory_order_acquire);
+
+    while (true)
+    {
+        size_t index = head & INDEX_PART;
+
+        if (index == 0)
+        {
+            if (grow (list) != list::OK)
+            {
+                return 0;
+            }
+
+            head = list->free_head.load (std::memory_order_acquire);
+            continue;
+        }
+
+        // Cell may be popped and reused meanwhile: value is stale, tag catches it
+        uint64_t next     = cell_at (list, index)->free_next.load (std::memory_order_relaxed);
+        uint64_t new_head = ((head >> INDEX_BITS) + 1) << INDEX_BITS | next;
+
+        if (list->free_head.compare_exchange_weak (head, new_head, std::memory_order_acquire,
+                                                                   std::memory_order_acquire))
+        {
+            return index;
+        }
+    }
+}
+
+// Pushes chain first..last, already linked through free_next
+static void push_free (list::conc_list_t *list, size_t first, size_t last)
+{
+    list::conc::cell_t *last_cell = cell_at (list, last);
+    uint64_t            head      = list->free_head.load (std::memory_order_relaxed);
+
+    while (true)
+    {
+        last_cell->free_next.store (uint32_t (head & INDEX_PART), std::memory_order_relaxed);
+
+        uint64_t new_head = ((head >> INDEX_BITS) + 1) << INDEX_BITS | first;
+
+        if (list->free_head.compare_exchange_weak (head, new_head, std::memory_order_release,
+                                                                   std::memory_order_relaxed))
+        {
+            return;
+        }
+    }
+}
+
+// Adds next chunk unless someone else did it while we were waiting for the lock
+static list::err_t grow (list::conc_list_t *list)
+{
+    std::lock_guard<std::mutex> guard (list->grow_mutex);
+
+    if ((list->free_head.load (std::memory_order_acquire) & INDEX_PART) != 0)
+    {
+        return list::OK;
+    }
+
+    return add_chunk (list);
+}
+
+// Old chunks stay in place, so readers are never blocked by growth
+static list::err_t add_chunk (list::conc_list_t *list)
+{
+    size_t n_chunks = list->n_chunks.load (std::memory_order_relaxed);
+
+    if (n_chunks == list::conc::MAX_CHUNKS)
+    {
+        log (log::ERR, "Concurrent list reached max capacity %zu", list::conc::MAX_CELLS - 1);
+        return list::CAPACITY_OVERFLOW;
+    }
+
+    size_t cells = chunk_cells (n_chunks);
+    size_t start = chunk_start (n_chunks);
+
+    list::conc::chunk_t *chunk = (list::conc::chunk_t *) calloc (1, sizeof (list::conc::chunk_t));
+    if (chunk == nullptr)
+    {
+        log (log::ERR, "OOM");
+        return list::OOM;
+    }
+
+    chunk->cells = new (std::nothrow) list::conc::cell_t[cells];
+    chunk->data  = (char *) calloc (cells, list->obj_size);
+
+    if (chunk->cells == nullptr || chunk->data == nullptr)
+    {
+        log (log::ERR, "OOM");
+        delete[] chunk->cells;
+        free (chunk->data);
+        free (chunk);
+        return list::OOM;
+    }
+
+    for (size_t i = 0; i < cells; ++i)
+    {
+        list::conc::cell_t *cell = &chunk->cells[i];
+
+        cell->next.store      (0,                        std::memory_order_relaxed);
+        cell->prev.store      (0,                        std::memory_order_relaxed);
+        cell->free_next.store (uint32_t (start + i + 1), std::memory_order_relaxed);
+        cell->lock.store      (false,                    std::memory_order_relaxed);
+        cell->live.store      (false,                    std::memory_order_relaxed);
+    }
+
+    list->chunks[n_chunks].store (chunk, std::memory_order_release);
+    list->n_chunks.store (n_chunks + 1, std::memory_order_release);
+
+    // Null cell is not a free cell
+    size_t first = (n_chunks == 0) ? 1 : start;
+    size_t last  = start + cells - 1;
+
+    list->capacity.fetch_add (last - first + 1, std::memory_order_release);
+    push_free (list, first, last);
+
+    return list::OK;
+}
@@ -0,0 +1,98 @@
+#ifndef CONCURRENT_LIST_H
+#define CONCURRENT_LIST_H
+
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "list.h"
+
+// ----------------------------------------------------------------------------
+// Thread-safe list variant.
+//  - Storage is a directory of chunks that double in size, cells never move,
+//    so growth doesn't stop readers.
+//  - Free cells form a Treiber stack, head is (ABA tag, index) in one word.
+//  - insert_after/remove lock only the cells whose links change (per-cell
+//    spinlocks, second and third lock are try-locks with retry, so lock order
+//    across the ring can't deadlock).
+//  - next/prev are plain atomic loads; a walker racing with remove of the
+//    cell it stands on may see a stale link, but never freed memory.
+// ----------------------------------------------------------------------------
+
+namespace list
+{
+    namespace conc
+    {
+        const size_t CHUNK_BASE = 64;
+        const size_t MAX_CHUNKS = 25;
+        const size_t MAX_CELLS  = CHUNK_BASE * (((size_t) 1 << MAX_CHUNKS) - 1);
+
+        struct cell_t
+        {
+            std::atomic<uint32_t> next      {0};
+            std::atomic<uint32_t> prev      {0};
+            std::atomic<uint32_t> free_next {0};
+            std::atomic<bool>     lock      {false};
+            std::atomic<bool>     live      {false};
+        };
+
+        struct chunk_t
+        {
+            cell_t *cells;
+            char   *data;
+        };
+    }
+
+    struct conc_list_t
+    {
+        std::atomic<conc::chunk_t *> chunks[conc::MAX_CHUNKS] = {};
+        std::atomic<size_t>          n_chunks {0};
+
+        std::atomic<uint64_t> free_head {0};    ///< tag << 32 | index
+
+        std::atomic<size_t> size     {0};
+        std::atomic<size_t> capacity {0};
+
+        size_t     obj_size   = 0;
+        std::mutex grow_mutex {};
+    };
+
+    namespace conc
+    {
+        err_t ctor (conc_list_t *list, size_t obj_size, size_t reserved = 0);
+        void  dtor (conc_list_t *list);
+
+        /**
+         * @brief Full check, only valid when no other thread mutates the list
+         */
+        [[nodiscard]]
+        err_flags verify (conc_list_t *list);
+
+        /**
+         * @brief Inserts after index, -1 if index was removed concurrently or on OOM
+         */
+        ssize_t insert_after (conc_list_t *list, size_t index, const void *elem);
+        ssize_t push_back    (conc_list_t *list, const void *elem);
+        ssize_t push_front   (conc_list_t *list, const void *elem);
+
+        /**
+         * @brief Removes cell, EMPTY if it isn't in the list (anymore)
+         */
+        err_t remove    (conc_list_t *list, size_t index, void *elem);
+        err_t pop_front (conc_list_t *list, void *elem);
+        err_t pop_back  (conc_list_t *list, void *elem);
+
+        /**
+         * @brief Copies payload under cell lock, false if cell isn't in the list
+         */
+        bool get (conc_list_t *list, size_t index, void *elem);
+
+        size_t next (conc_list_t *list, size_t index);
+        size_t prev (conc_list_t *list, size_t index);
+        size_t head (conc_list_t *list);
+        size_t tail (conc_list_t *list);
+    }
+}
+
+#endif //CONCURRENT_LIST_H
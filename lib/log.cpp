@@ -3,10 +3,48 @@
 #include <assert.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
 #include "log.h"
 
 log __LOG_LEVEL = log::WRN;
 FILE *__LOG_OUT_STREAM = stdout;
+std::atomic<bool> __LOG_ASYNC (false);
+
+// ----------------------------------------------------------------------------
+// Async ring: bounded MPMC queue with per-slot sequence numbers. Producers
+// claim slots with one CAS, consumer side is serialized by drain_mutex.
+// ----------------------------------------------------------------------------
+
+static const size_t RING_SIZE = 1024;   // power of two
+
+struct ring_slot
+{
+    std::atomic<size_t> seq {0};
+    __log_record        rec {};
+};
+
+static ring_slot           *ring        = nullptr;
+static std::atomic<size_t>  enqueue_pos (0);
+static size_t               dequeue_pos = 0;
+
+static std::mutex               drain_mutex;
+static std::mutex               wake_mutex;
+static std::condition_variable  wake_cv;
+static std::thread              writer;
+static std::atomic<bool>        writer_stop (false);
+
+static void writer_loop  ();
+static void drain        ();
+static void write_header (FILE *stream, enum log lvl, time_t sec, const char *file, unsigned int line);
+static void write_record (FILE *stream, const __log_record *rec);
+static void stop_async   ();
+
+// ----------------------------------------------------------------------------
 
 void set_log_level (log level)
 {
@@ -17,6 +55,8 @@ void set_log_stream (FILE *stream)
 {
     assert (stream != NULL);
 
+    drain ();
+
     __LOG_OUT_STREAM = stream;
 
     #if HTML_LOGS
@@ -26,29 +66,291 @@ void set_log_stream (FILE *stream)
 
 FILE *get_log_stream ()
 {
+    drain ();
+
     return __LOG_OUT_STREAM;
 }
 
-void _log (log lvl, const char *fmt, const char *file, unsigned int line...)
+void set_log_async (bool enable)
+{
+    if (enable == __LOG_ASYNC.load ())
+    {
+        return;
+    }
+
+    if (!enable)
+    {
+        stop_async ();
+        return;
+    }
+
+    if (ring == nullptr)
+    {
+        ring = new (std::nothrow) ring_slot[RING_SIZE];
+        if (ring == nullptr)
+        {
+            return;
+        }
+
+        for (size_t i = 0; i < RING_SIZE; ++i)
+        {
+            ring[i].seq.store (i, std::memory_order_relaxed);
+        }
+
+        atexit (stop_async);
+    }
+
+    writer_stop.store (false);
+    writer = std::thread (writer_loop);
+
+    __LOG_ASYNC.store (true);
+}
+
+void log_flush ()
+{
+    drain ();
+    fflush (__LOG_OUT_STREAM);
+}
+
+// ----------------------------------------------------------------------------
+
+__log_record *_log_claim ()
+{
+    size_t pos = enqueue_pos.load (std::memory_order_relaxed);
+
+    while (true)
+    {
+        ring_slot *slot = &ring[pos & (RING_SIZE - 1)];
+        size_t     seq  = slot->seq.load (std::memory_order_acquire);
+
+        if (seq == pos)
+        {
+            if (enqueue_pos.compare_exchange_weak (pos, pos + 1, std::memory_order_relaxed))
+            {
+                slot->rec.pos = pos;
+                return &slot->rec;
+            }
+        }
+        else if (seq < pos)
+        {
+            // Ring is full: wake writer and wait for it
+            wake_cv.notify_one ();
+            std::this_thread::yield ();
+            pos = enqueue_pos.load (std::memory_order_relaxed);
+        }
+        else
+        {
+            pos = enqueue_pos.load (std::memory_order_relaxed);
+        }
+    }
+}
+
+void _log_commit (__log_record *rec)
+{
+    ring[rec->pos & (RING_SIZE - 1)].seq.store (rec->pos + 1, std::memory_order_release);
+
+    // Warnings and errors are written out right away
+    if (rec->lvl >= log::WRN)
+    {
+        wake_cv.notify_one ();
+    }
+}
+
+void _log_sync (log lvl, const char *fmt, const char *file, unsigned int line...)
 {
     va_list args;
     va_start (args, line);
 
-    if (lvl >= __LOG_LEVEL)                                             
-    {                                                                   
-        char time_buf[__TIME_BUF_SIZE] = "";                            
-        current_time (time_buf, __TIME_BUF_SIZE);                       
-        fprintf (__LOG_OUT_STREAM, "%s ", time_buf);                    
-                                                                        
-        if      (lvl == log::DBG) { fprintf (__LOG_OUT_STREAM, "DEBUG"); }                 
-        else if (lvl == log::INF) { fprintf (__LOG_OUT_STREAM, Cyan "INFO " D); }          
-        else if (lvl == log::WRN) { fprintf (__LOG_OUT_STREAM, Y "WARN " D); fflush (__LOG_OUT_STREAM); }             
-        else if (lvl == log::ERR) { fprintf (__LOG_OUT_STREAM, R "ERROR" D); fflush (__LOG_OUT_STREAM); }             
-                                                                        
-        fprintf (__LOG_OUT_STREAM, " [%s:%u] ", file, line);    
-        vfprintf (__LOG_OUT_STREAM, fmt, args);                        
-        fputc   ('\n', __LOG_OUT_STREAM);                               
-    }       
-
-    va_end (args);                                                            
-}
\ No newline at end of file
+    write_header (__LOG_OUT_STREAM, lvl, time (nullptr), file, line);
+    vfprintf (__LOG_OUT_STREAM, fmt, args);
+    fputc   ('\n', __LOG_OUT_STREAM);
+
+    if (lvl >= log::WRN)
+    {
+        fflush (__LOG_OUT_STREAM);
+    }
+
+    va_end (args);
+}
+
+// ----------------------------------------------------------------------------
+
+static void writer_loop ()
+{
+    while (!writer_stop.load ())
+    {
+        {
+            std::unique_lock<std::mutex> lock (wake_mutex);
+            wake_cv.wait_for (lock, std::chrono::milliseconds (10));
+        }
+
+        drain ();
+    }
+
+    drain ();
+}
+
+static void drain ()
+{
+    if (ring == nullptr)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock (drain_mutex);
+
+    bool need_flush = false;
+
+    while (true)
+    {
+        ring_slot *slot = &ring[dequeue_pos & (RING_SIZE - 1)];
+
+        if (slot->seq.load (std::memory_order_acquire) != dequeue_pos + 1)
+        {
+            break;
+        }
+
+        write_record (__LOG_OUT_STREAM, &slot->rec);
+        need_flush |= slot->rec.lvl >= log::WRN;
+
+        slot->seq.store (dequeue_pos + RING_SIZE, std::memory_order_release);
+        dequeue_pos++;
+    }
+
+    if (need_flush)
+    {
+        fflush (__LOG_OUT_STREAM);
+    }
+}
+
+static void stop_async ()
+{
+    if (!__LOG_ASYNC.load ())
+    {
+        return;
+    }
+
+    __LOG_ASYNC.store (false);
+
+    writer_stop.store (true);
+    wake_cv.notify_one ();
+    writer.join ();
+
+    log_flush ();
+}
+
+// ----------------------------------------------------------------------------
+
+// localtime + strftime only once per second per thread
+static void write_header (FILE *stream, enum log lvl, time_t sec, const char *file, unsigned int line)
+{
+    thread_local time_t cached_sec = -1;
+    thread_local char   time_buf[__TIME_BUF_SIZE] = "";
+
+    if (sec != cached_sec)
+    {
+        struct tm timeinfo = {};
+        localtime_r (&sec, &timeinfo);
+        strftime (time_buf, __TIME_BUF_SIZE, "%H:%M:%S", &timeinfo);
+        cached_sec = sec;
+    }
+
+    const char *lvl_str = "";
+    if      (lvl == log::DBG) { lvl_str = "DEBUG"; }
+    else if (lvl == log::INF) { lvl_str = Cyan "INFO " D; }
+    else if (lvl == log::WRN) { lvl_str = Y "WARN " D; }
+    else if (lvl == log::ERR) { lvl_str = R "ERROR" D; }
+
+    fprintf (stream, "%s %s [%s:%u] ", time_buf, lvl_str, file, line);
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+
+// Walks format string and prints every conversion with its stored argument
+static void write_record (FILE *stream, const __log_record *rec)
+{
+    write_header (stream, rec->lvl, rec->sec, rec->file, rec->line);
+
+    const char *fmt     = rec->fmt;
+    size_t      arg_num = 0;
+
+    while (*fmt != '\0')
+    {
+        const char *pct = strchr (fmt, '%');
+        if (pct == nullptr)
+        {
+            fputs (fmt, stream);
+            break;
+        }
+
+        fwrite (fmt, 1, (size_t) (pct - fmt), stream);
+
+        if (pct[1] == '%')
+        {
+            fputc ('%', stream);
+            fmt = pct + 2;
+            continue;
+        }
+
+        // Flags, width and precision are kept, length modifier is replaced
+        const char *spec_end = pct + 1 + strspn (pct + 1, "-+ #0'123456789.");
+        const char *conv     = spec_end + strspn (spec_end, "hlLqjzt");
+
+        char   spec[32] = "";
+        size_t head_len = (size_t) (spec_end - pct);
+        if (*conv == '\0' || head_len + 4 > sizeof (spec) || arg_num >= rec->nargs)
+        {
+            fputs (pct, stream);
+            break;
+        }
+        memcpy (spec, pct, head_len);
+
+        const __log_arg *arg = &rec->args[arg_num++];
+        long long          i = (arg->kind == 'u') ? (long long) arg->u : arg->i;
+        unsigned long long u = (arg->kind == 'i') ? (unsigned long long) arg->i : arg->u;
+
+        switch (*conv)
+        {
+            case 'd': case 'i':
+                memcpy (spec + head_len, "ll", 2); spec[head_len + 2] = *conv;
+                fprintf (stream, spec, i);
+                break;
+
+            case 'u': case 'o': case 'x': case 'X':
+                memcpy (spec + head_len, "ll", 2); spec[head_len + 2] = *conv;
+                fprintf (stream, spec, u);
+                break;
+
+            case 'c':
+                spec[head_len] = *conv;
+                fprintf (stream, spec, (int) i);
+                break;
+
+            case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+                spec[head_len] = *conv;
+                fprintf (stream, spec, arg->d);
+                break;
+
+            case 's':
+                spec[head_len] = *conv;
+                fprintf (stream, spec, (arg->kind == 's') ? rec->strs + arg->str : "(?)");
+                break;
+
+            case 'p':
+                spec[head_len] = *conv;
+                fprintf (stream, spec, arg->p);
+                break;
+
+            default:
+                fwrite (pct, 1, (size_t) (conv - pct + 1), stream);
+                break;
+        }
+
+        fmt = conv + 1;
+    }
+
+    fputc ('\n', stream);
+}
+
+#pragma GCC diagnostic pop
@@ -3,7 +3,10 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
+#include <atomic>
+#include <type_traits>
 
 #ifndef HTML_LOGS
     #define HTML_LOGS 1
@@ -23,10 +26,57 @@ enum class log
 
 const size_t __TIME_BUF_SIZE = 10;
 
-#ifndef __LOG_CPP
+// Calls below this level are removed at compile time
+#ifndef LOG_MIN_LEVEL
+    #ifdef NDEBUG
+        #define LOG_MIN_LEVEL 2
+    #else
+        #define LOG_MIN_LEVEL 1
+    #endif
+#endif
+
+// ----------------------------------------------------------------------------
+// Async mode: callers put format pointer and raw arguments into a lock-free
+// ring, background thread formats and writes them. Strings are copied.
+// ----------------------------------------------------------------------------
+
+const size_t __LOG_MAX_ARGS = 8;
+const size_t __LOG_STR_SIZE = 256;
+
+struct __log_arg
+{
+    char kind;  // 'i', 'u', 'd', 'p' or 's' (offset in strs)
+
+    union
+    {
+        long long           i;
+        unsigned long long  u;
+        double              d;
+        const void         *p;
+        size_t              str;
+    };
+};
+
+struct __log_record
+{
+    size_t       pos;   // ring position, set by _log_claim
+
+    enum log     lvl;
+    const char  *fmt;
+    const char  *file;
+    unsigned int line;
+    time_t       sec;
+
+    size_t       nargs;
+    __log_arg    args[__LOG_MAX_ARGS];
+
+    size_t       strs_used;
+    char         strs[__LOG_STR_SIZE];
+};
+
 extern enum log __LOG_LEVEL;
 extern FILE *__LOG_OUT_STREAM;
-#endif
+extern std::atomic<bool> __LOG_ASYNC;
 
 #if HTML_LOGS
     #define R       "<font color=\"red\">"
@@ -59,12 +109,95 @@ static inline void current_time (char *buf, size_t buf_size);
  */
 #ifndef DISABLE_LOGS
 
-void _log (enum log lvl, const char *fmt, const char *file, unsigned int line, ...);
+void _log_sync (enum log lvl, const char *fmt, const char *file, unsigned int line, ...);
+
+__log_record *_log_claim  ();
+void          _log_commit (__log_record *rec);
+
+template <typename T>
+inline void _log_pack (__log_record *rec, T val)
+{
+    __log_arg *arg = &rec->args[rec->nargs++];
+
+    if constexpr (std::is_same_v<T, char *> || std::is_same_v<T, const char *>)
+    {
+        arg->kind = 's';
+
+        // Buffer is full: last byte is the NUL of the previous string
+        if (rec->strs_used >= __LOG_STR_SIZE)
+        {
+            arg->str = __LOG_STR_SIZE - 1;
+            return;
+        }
 
-#define log(lvl, fmt, ...)                               \
-{                                                        \
-    _log (lvl, fmt, __FILE__, __LINE__, ##__VA_ARGS__);  \
-}                                                       
+        size_t len  = (val != nullptr) ? strlen (val) : 0;
+        size_t left = __LOG_STR_SIZE - rec->strs_used - 1;
+        if (len > left) len = left;
+
+        arg->str  = rec->strs_used;
+        memcpy (rec->strs + rec->strs_used, (val != nullptr) ? val : "", len);
+        rec->strs[rec->strs_used + len] = '\0';
+        rec->strs_used += len + 1;
+    }
+    else if constexpr (std::is_floating_point_v<T>)
+    {
+        arg->kind = 'd';
+        arg->d    = (double) val;
+    }
+    else if constexpr (std::is_pointer_v<T> || std::is_null_pointer_v<T>)
+    {
+        arg->kind = 'p';
+        arg->p    = (const void *) val;
+    }
+    else if constexpr (std::is_signed_v<T> || std::is_enum_v<T>)
+    {
+        arg->kind = 'i';
+        arg->i    = (long long) val;
+    }
+    else
+    {
+        arg->kind = 'u';
+        arg->u    = (unsigned long long) val;
+    }
+}
+
+template <typename... Args>
+inline void _log (enum log lvl, const char *fmt, const char *file, unsigned int line, Args... args)
+{
+    if (lvl < __LOG_LEVEL)
+    {
+        return;
+    }
+
+    if constexpr (sizeof... (args) <= __LOG_MAX_ARGS)
+    {
+        if (__LOG_ASYNC.load (std::memory_order_relaxed))
+        {
+            __log_record *rec = _log_claim ();
+
+            rec->lvl       = lvl;
+            rec->fmt       = fmt;
+            rec->file      = file;
+            rec->line      = line;
+            rec->sec       = time (nullptr);
+            rec->nargs     = 0;
+            rec->strs_used = 0;
+
+            (_log_pack (rec, args), ...);
+
+            _log_commit (rec);
+            return;
+        }
+    }
+
+    _log_sync (lvl, fmt, file, line, args...);
+}
+
+#define log(lvl, fmt, ...)                                          \
+{                                                                   \
+    if constexpr ((int) (lvl) >= LOG_MIN_LEVEL)                     \
+        _log (lvl, fmt, __FILE__, __LINE__, ##__VA_ARGS__);         \
+}
 
 #else
 
@@ -86,8 +219,23 @@ void set_log_level (enum log level);
  */
 void set_log_stream (FILE *stream);
 
+/**
+ * @brief      Returns log stream, pending async records are written out first,
+ *             so direct writes to the stream keep their order
+ */
 FILE *get_log_stream ();
 
+/**
+ * @brief      Switches async mode: enabling starts writer thread, disabling
+ *             drains the ring and joins it. Pending records are also written at exit.
+ */
+void set_log_async (bool enable);
+
+/**
+ * @brief      Writes all pending records and flushes the stream
+ */
+void log_flush ();
+
 /**
  * @brief      Write current time in HH:MM:SS format to given buffer
  *
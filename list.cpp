@@ -1,19 +1,154 @@
 #include <assert.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdarg.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "include/common.h"
 #include "lib/log.h"
 #include "list.h"
+#include "order_index.h"
+#include "allocator.h"
+#include "list_iterator.h"
 
 // ----------------------------------------------------------------------------
 // CONST SECTION
 // ----------------------------------------------------------------------------
 
-static const size_t FREE_PREV = (size_t) -1;
+// Free cell encoding is shared with queue and search code through list.h
+using list::FREE_FLAG;
+using list::INDEX_MASK;
+using list::to_index;
+
+// Auto shrink triggers when at most capacity / SHRINK_LOAD cells are used
+static const size_t SHRINK_LOAD = 4;
+
+// Parallel linearisation: shorter lists go to the serial copy, each thread
+// gets about this many sublists to even out their random lengths
+static const size_t PARALLEL_MIN_SIZE = 1 << 14;
+static const size_t RULERS_PER_THREAD = 64;
+
+// insert_after looks this many cells around index + 1 for a free one
+static const size_t LOCAL_PROBE = 8;
+
+// Snapshot stream: header, then blocks of [count, payload, checksum]
+static const char     SNAPSHOT_MAGIC[8] = {'L', 'I', 'S', 'T', 'S', 'N', 'A', 'P'};
+static const uint32_t SNAPSHOT_VERSION  = 2;
+static const size_t   SNAPSHOT_BLOCK    = 1 << 20;
+
+enum snapshot_mode_t : uint8_t
+{
+    SNAPSHOT_LINEAR = 0,
+    SNAPSHOT_RAW    = 1
+};
+
+struct snapshot_header_t
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t index_bits;
+
+    uint64_t obj_size;
+    uint64_t capacity;
+    uint64_t size;
+    uint64_t free_head;
+    uint64_t free_back;
+
+    uint8_t  mode;
+    uint8_t  is_sorted;
+    uint8_t  reserved[6];
+
+    uint64_t header_sum;    ///< checksum of the fields above
+};
+
 static const size_t DUMP_FILE_PATH_LEN = 15;
 static const char DUMP_FILE_PATH_FORMAT[] = "dump/%d.grv";
 
+// Dump pipeline: graph_dump copies the list, workers write .grv, run dot
+// and append the log entry
+static const size_t DUMP_REASON_LEN      = 256;
+static const size_t DUMP_DEFAULT_WORKERS = 1;
+static const size_t DUMP_DEFAULT_PENDING = 16;
+
+// Cells to show are copied out at dump time with their state, cells between
+// them are only counted
+static const size_t DUMP_STREAM_BUFFER = 1 << 20;
+static const size_t DUMP_MAX_BROKEN    = 32;
+
+enum dump_cell_state_t : uint8_t
+{
+    DUMP_CELL_NULL    = 0,
+    DUMP_CELL_FREE    = 1,
+    DUMP_CELL_LIVE    = 2,
+    DUMP_CELL_INVALID = 3
+};
+
+struct dump_cell_t
+{
+    size_t            index;
+    size_t            next;
+    size_t            prev;
+    dump_cell_state_t state;
+};
+
+struct dump_gap_t
+{
+    size_t first;
+    size_t last;
+    size_t live;
+    size_t free;
+};
+
+struct dump_capture_t
+{
+    list::list_t header;    ///< fields only, arrays are not owned
+
+    dump_cell_t *cells;     ///< sorted by index
+    size_t       n_cells;
+    char        *data;      ///< payload of cells[i] at i * obj_size
+
+    dump_gap_t  *gaps;
+    size_t       n_gaps;
+};
+
+struct dump_job_t
+{
+    dump_capture_t *capture;
+    int             number;
+    size_t        skipped;      ///< dumps dropped in favour of this one
+    char          reason[DUMP_REASON_LEN];
+};
+
+struct dump_pipeline_t
+{
+    std::mutex              mutex   {};
+    std::condition_variable work_cv {};
+    std::condition_variable done_cv {};
+
+    std::deque<dump_job_t>   queue   {};
+    std::vector<std::thread> threads {};
+
+    size_t workers     = DUMP_DEFAULT_WORKERS;
+    size_t max_pending = DUMP_DEFAULT_PENDING;
+    size_t interval_ms = 0;
+    size_t in_flight   = 0;
+    bool   stop        = false;
+    bool   at_exit     = false;
+
+    std::chrono::steady_clock::time_point last_enqueue {};
+    list::dump_stats_t                    stats        {};
+    list::dump_window_t                   window       {list::DUMP_ALL, 0, 0};
+};
+
+static dump_pipeline_t dumps;
+
 const int INDEX_MAX_LEN = 10;
 
 // ----------------------------------------------------------------------------
@@ -50,6 +185,12 @@ const int NUM_OF_TRIES  = 3;
 // STATIC DEFINITIONS
 // ----------------------------------------------------------------------------
 
+#if LIST_STATS
+    #define _STAT(list, field, delta) { (list)->counters.field += (delta); }
+#else
+    #define _STAT(list, field, delta) {;}
+#endif
+
 #define UNWRAP_MALLOC(val)    \
 {                             \
     if ((val) == nullptr)     \
@@ -59,25 +200,101 @@ const int NUM_OF_TRIES  = 3;
     }                         \
 }
 
+static list::err_t write_blocks (FILE *stream, const void *arr, size_t elem_size, size_t count);
+static list::err_t read_blocks  (FILE *stream, void *arr, size_t elem_size, size_t count);
+static list::err_t write_block  (FILE *stream, const void *block, size_t elem_size, size_t count);
+static list::err_t read_block   (FILE *stream, void *block, size_t elem_size, size_t count);
+static uint64_t    checksum     (const void *data, size_t size);
+
+static void *mem_alloc   (const list::list_t *list, size_t size);
+static void  mem_free    (const list::list_t *list, void *ptr, size_t size);
+
 static list::err_t recalloc_no_sorting  (list::list_t *list, size_t new_capacity);
 static list::err_t recalloc_and_sorting (list::list_t *list, size_t new_capacity);
+static void linearise_in_place (list::list_t *list);
+static void relink_cells       (list::list_t *list, size_t from, size_t to);
+static void relink_ends        (list::list_t *list);
 
-static ssize_t get_free_cell (list::list_t *list);
+// Sublist of the ruling set: starts at ruler cell, ends before the next ruler
+struct ruler_t
+{
+    size_t cell;
+    size_t length;
+    size_t next;    ///< id of the following ruler, SIZE_MAX for the last one
+    size_t base;    ///< rank of the ruler cell
+};
+
+static list::err_t linearise_parallel (list::list_t *list, size_t threads);
+static size_t      pick_rulers        (list::list_t *list, ruler_t *rulers, size_t max_rulers);
+template <typename Task>
+static void        run_parallel       (size_t threads, size_t tasks, Task task);
+
+struct sort_key_t
+{
+    uint64_t key;
+    size_t   cell;
+};
+
+static size_t merge_runs  (list::list_t *list, size_t first, size_t second,
+                           int (*cmp)(const void *a, const void *b));
+static void   radix_pass  (const sort_key_t *src, sort_key_t *dst, size_t count,
+                           const size_t *counts, size_t shift);
+static void   relink_prev (list::list_t *list);
+static void   finish_value_sort (list::list_t *list, bool linearise);
+
+#if LIST_STATS
+static size_t now_ns ();
+#endif
+
+static ssize_t get_free_cell     (list::list_t *list, size_t hint);
+static size_t  nearest_free_cell (const list::list_t *list, size_t hint);
+static list::err_t reserve_cells (list::list_t *list, size_t min_capacity);
+static list::err_t insert_run    (list::list_t *list, size_t index, const void *elems,
+                                  size_t count, size_t *first_res);
+static list::err_t copy_range    (list::list_t *dst, size_t dst_pos, const list::list_t *src,
+                                  size_t first, size_t last, size_t *min_cell);
+static void release_range (list::list_t *list, size_t first, size_t last);
+static void relink_range  (list::list_t *list, size_t dst_pos, size_t first, size_t last);
+static list::err_t shrink_cells (list::list_t *list, size_t new_capacity, bool linearise);
+static void        auto_shrink  (list::list_t *list);
+static bool is_free_run (const list::list_t *list, size_t from, size_t count);
 static void release_free_cell (list::list_t *list, size_t index);
+static void unlink_free_cell  (list::list_t *list, size_t index);
+static inline bool is_free_cell (const list::list_t *list, size_t index);
+
+static size_t compact_cells (list::list_t *list, size_t budget, size_t *tracked);
+static void   move_cell  (list::list_t *list, size_t from, size_t to);
+static void   swap_cells (list::list_t *list, size_t a, size_t b);
 
 static bool check_cell  (const list::list_t *list, size_t index);
+static bool check_links (const list::list_t *list, size_t index);
 static bool check_index  (const list::list_t *list, size_t index, bool can_be_zero);
 static void verify_data_loop  (const list::list_t *list, list::err_flags *flags);
 static void verify_free_loop  (const list::list_t *list, list::err_flags *flags);
 
-static void generate_graphiz_code (const list::list_t *list, FILE *stream);
-static void set_colors (const list::list_t *list, size_t index,
-                        const char **fillcolor, const char **color);
-static void node_codegen (const list::list_t *list, size_t index, const char *fillcolor,
-                          const char *color, FILE *stream);
-static void edge_codegen (const list::list_t *list, size_t index, FILE *stream);
-
+static dump_capture_t *capture_dump (const list::list_t *list, const list::dump_window_t *window);
+static void            free_capture (dump_capture_t *capture);
+static void select_cells (const list::list_t *list, const list::dump_window_t *window,
+                          std::vector<size_t> *cells);
+static void add_cell_range (const list::list_t *list, std::vector<size_t> *cells,
+                            size_t center, size_t radius);
+static dump_cell_state_t cell_state (const list::list_t *list, size_t index);
+static void enqueue_dump (dump_job_t *job);
+static void render_dump  (dump_job_t *job);
+static void dump_worker  ();
+static void stop_dump_workers ();
+
+static void generate_graphiz_code (const dump_capture_t *capture, FILE *stream);
+static void set_colors (dump_cell_state_t state, const char **fillcolor, const char **color);
+static void node_codegen (const dump_capture_t *capture, size_t pos, FILE *stream);
+static void edge_codegen (const dump_capture_t *capture, size_t pos, FILE *stream);
+static void gap_codegen  (const dump_gap_t *gap, FILE *stream);
+static void ref_codegen  (const dump_capture_t *capture, size_t index, FILE *stream);
+static bool is_captured  (const dump_capture_t *capture, size_t index);
+
+#ifdef CRINGE_MODE
 static bool cringe_get_iter_wrapper (size_t index);
+#endif
 
 // ----------------------------------------------------------------------------
 // PUBLIC FUNCTIONS
@@ -92,25 +309,34 @@ static bool cringe_get_iter_wrapper (size_t index);
 }
 
 list::err_t list::ctor (list_t *list, size_t obj_size, size_t reserved,
-                                void (*print_func)(void *elem, FILE *stream))
+                                void (*print_func)(void *elem, FILE *stream),
+                                const allocator_t *allocator)
 {
     assert (list != nullptr && "pointer can't be nullptr");
     assert (obj_size > 0 && "Object size can't be less than 1");
     assert (print_func != nullptr && "pointer can't be nullptr");
 
     //Nuke them
-    list->data_arr = nullptr;
-    list->prev_arr = nullptr;
-    list->next_arr = nullptr;
+    list->data_arr  = nullptr;
+    list->prev_arr  = nullptr;
+    list->next_arr  = nullptr;
+    list->allocator = allocator;
+
+    if (reserved > list::MAX_CAPACITY)
+    {
+        log (log::ERR, "Reserved %zu cells, index type allows only %zu", reserved, list::MAX_CAPACITY);
+        return list::CAPACITY_OVERFLOW;
+    }
 
     // Allocate null object + reserved
-    list->data_arr = calloc (reserved + 1, obj_size);
+    list->data_arr = mem_alloc (list, (reserved + 1) * obj_size);
     _UNWRAP_MALLOC_GOTO (list->data_arr);
+    memset (list->data_arr, 0, (reserved + 1) * obj_size);
 
-    list->prev_arr = (size_t*) calloc (reserved + 1, sizeof (size_t)); 
+    list->prev_arr = (list::index_t *) mem_alloc (list, (reserved + 1) * sizeof (list::index_t));
     _UNWRAP_MALLOC_GOTO (list->prev_arr);
 
-    list->next_arr = (size_t*) calloc (reserved + 1, sizeof (size_t)); 
+    list->next_arr = (list::index_t *) mem_alloc (list, (reserved + 1) * sizeof (list::index_t));
     _UNWRAP_MALLOC_GOTO (list->next_arr);
 
     // Init fields
@@ -121,6 +347,13 @@ list::err_t list::ctor (list_t *list, size_t obj_size, size_t reserved,
     list->is_sorted  = true;
     list->print_func = print_func;
 
+    list->order_index    = nullptr;
+    list->compact_pos    = 1;
+    list->compact_budget = 0;
+    list->auto_shrink    = false;
+
+    list::reset_stats (list);
+
     // Init null cell
     list->prev_arr[0] = 0;
     list->next_arr[0] = 0;
@@ -128,19 +361,19 @@ list::err_t list::ctor (list_t *list, size_t obj_size, size_t reserved,
     // Init free cells
     for (size_t i = 1; i <= reserved; ++i)
     {
-        list->next_arr[i] = i + 1;
-        list->prev_arr[i] = FREE_PREV;
+        list->next_arr[i] = to_index (i + 1);
+        list->prev_arr[i] = to_index (FREE_FLAG | (i - 1));
     }
     list->next_arr[reserved] = 0;
-    list->free_head          = (reserved > 0) ? 1 : 0;
-    list->free_back          = reserved;
+    list->free_head          = to_index ((reserved > 0) ? 1 : 0);
+    list->free_back          = to_index (reserved);
 
     return list::OK;
 
     failed_malloc_cleanup:
-        free (list->data_arr);
-        free (list->prev_arr);
-        free (list->next_arr);
+        mem_free (list, list->next_arr, (reserved + 1) * sizeof (list::index_t));
+        mem_free (list, list->prev_arr, (reserved + 1) * sizeof (list::index_t));
+        mem_free (list, list->data_arr, (reserved + 1) * obj_size);
         return list::OOM;
 }
 
@@ -158,9 +391,11 @@ void list::dtor (list_t *list)
         list::print_errs (verify (list), get_log_stream(), "-->\t");
     }
 
-    free (list->data_arr);
-    free (list->prev_arr);
-    free (list->next_arr);
+    mem_free (list, list->next_arr, (list->capacity + 1) * sizeof (list::index_t));
+    mem_free (list, list->prev_arr, (list->capacity + 1) * sizeof (list::index_t));
+    mem_free (list, list->data_arr, (list->capacity + 1) * list->obj_size);
+
+    list::disable_order_index (list);
 }
 
 // ----------------------------------------------------------------------------
@@ -174,7 +409,7 @@ list::err_flags list::verify (const list_t *list)
 
     list::err_flags flags = list::OK;
 
-    if (list->capacity < list->reserved)
+    if (list->capacity < list->reserved || list->capacity > list::MAX_CAPACITY)
     {
         flags |= list::INVALID_CAPACITY;
     }
@@ -195,6 +430,47 @@ list::err_flags list::verify (const list_t *list)
 
 // ----------------------------------------------------------------------------
 
+list::err_flags list::verify_local (const list_t *list, size_t index)
+{
+    if (list == nullptr)
+    {
+        return list::NULLPTR;
+    }
+
+    list::err_flags flags = list::OK;
+
+    if (list->capacity < list->reserved || list->capacity > list::MAX_CAPACITY)
+    {
+        flags |= list::INVALID_CAPACITY;
+    }
+
+    if (list->size > list->capacity)
+    {
+        flags |= list::INVALID_SIZE;
+    }
+
+    if (flags != list::OK)
+    {
+        return flags;
+    }
+
+    if (list->free_head > list->capacity || (list->free_head == 0) != (list->size == list->capacity) ||
+        (list->free_head != 0 && !is_free_cell (list, list->free_head)))
+    {
+        flags |= list::BROKEN_FREE_LOOP;
+    }
+
+    if (index > list->capacity || !check_links (list, 0) ||
+        (!is_free_cell (list, index) && !check_links (list, index)))
+    {
+        flags |= list::BROKEN_DATA_LOOP;
+    }
+
+    return flags;
+}
+
+// ----------------------------------------------------------------------------
+
 #define _PRINT_CASE(err, message)                    \
 {                                                    \
     if (flags & err)                                 \
@@ -225,6 +501,9 @@ void list::print_errs (list::err_flags flags, FILE *file, const char *prefix)
     _PRINT_CASE (INVALID_SIZE, "Invalid size");
     _PRINT_CASE (BROKEN_DATA_LOOP, "Broken data loop");
     _PRINT_CASE (BROKEN_FREE_LOOP, "Broken free loop");
+    _PRINT_CASE (CAPACITY_OVERFLOW, "Capacity doesn't fit into index type");
+    _PRINT_CASE (IO_ERROR, "I/O error");
+    _PRINT_CASE (BAD_FORMAT, "Bad file format");
 
     assert (flags == list::OK && "Unknow error flag");
 }
@@ -236,15 +515,23 @@ ssize_t list::insert_after (list_t *list, size_t index, const void *elem)
     assert (list != nullptr && "pointer can't be nullptr");
     assert (elem != nullptr && "pointer can't be nullptr");
     list_assert (list);
+    list_assert_cell (list, index);
     assert (check_index (list, index, true) && "invalid index");
 
+    // Logical neighbours want adjacent cells: right after index, or right
+    // before the head when inserting at the front
+    size_t old_next = list->next_arr[index];
+    size_t hint     = (index != 0) ? index + 1 : (old_next > 1) ? old_next - 1 : 1;
+
     // Find free cell
-    ssize_t free_index_tmp = get_free_cell (list);
+    ssize_t free_index_tmp = get_free_cell (list, hint);
     if (free_index_tmp == -1) return -1;
 
     size_t free_index = (size_t) free_index_tmp;
 
-    if (free_index != index + 1)
+    // Linear run survives only if the new cell extends it at either end
+    if ((index != 0 && free_index != index + 1) ||
+        (old_next != 0 && old_next != free_index + 1))
     {
         list->is_sorted = false;
     }
@@ -255,10 +542,26 @@ ssize_t list::insert_after (list_t *list, size_t index, const void *elem)
     memcpy (cell_data_ptr, elem, list->obj_size);
 
     // Update pointers
-    list->prev_arr[list->next_arr[index]] = free_index;
+    list->prev_arr[list->next_arr[index]] = to_index (free_index);
     list->next_arr[free_index] = list->next_arr[index];
-    list->prev_arr[free_index] = index;
-    list->next_arr[index]      = free_index;
+    list->prev_arr[free_index] = to_index (index);
+    list->next_arr[index]      = to_index (free_index);
+
+    if (list->order_index != nullptr)
+    {
+        list::order::insert_after (list->order_index, index, free_index);
+    }
+
+    // Linearised prefix ends at index, new cell breaks it
+    if (index + 1 < list->compact_pos)
+    {
+        list->compact_pos = index + 1;
+    }
+
+    if (list->compact_budget > 0)
+    {
+        compact_cells (list, list->compact_budget, &free_index);
+    }
 
     return (ssize_t) free_index;
 }
@@ -267,9 +570,9 @@ ssize_t list::insert_before (list_t *list, size_t index, const void *elem)
 {
     assert (list != nullptr && "pointer can't be nullptr");
     assert (elem != nullptr && "pointer can't be nullptr");
-    list_assert (list);
     assert (check_index (list, index, true) && "invalid index");
 
+    // insert_after verifies the list
     return list::insert_after (list, list->prev_arr[index], elem);
 }
 
@@ -277,27 +580,141 @@ ssize_t list::push_back (list_t *list, const void *elem)
 {
     assert (list != nullptr && "pointer can't be null");
     assert (elem != nullptr && "pointer can't be null");
-    list_assert (list);
 
-    return list::insert_before (list, 0, elem);
+    return list::insert_after (list, list->prev_arr[0], elem);
 }
 
 ssize_t list::push_front (list_t *list, const void *elem)
 {
     assert (list != nullptr && "pointer can't be null");
     assert (elem != nullptr && "pointer can't be null");
-    list_assert (list);
 
     return list::insert_after (list, 0, elem);
 }
 
 // ----------------------------------------------------------------------------
 
+ssize_t list::insert_range_after (list_t *list, size_t index, const void *elems, size_t count)
+{
+    assert (list  != nullptr && "pointer can't be nullptr");
+    assert (elems != nullptr && "pointer can't be nullptr");
+    list_assert (list);
+    list_assert_cell (list, index);
+    assert (check_index (list, index, true) && "invalid index");
+
+    if (count == 0)
+    {
+        return (ssize_t) index;
+    }
+
+    size_t first = 0;
+    if (insert_run (list, index, elems, count, &first) != list::OK)
+    {
+        return ERROR;
+    }
+
+    if (list->compact_budget > 0)
+    {
+        compact_cells (list, list->compact_budget, &first);
+    }
+
+    return (ssize_t) first;
+}
+
+ssize_t list::push_back_n (list_t *list, const void *elems, size_t count)
+{
+    assert (list  != nullptr && "pointer can't be nullptr");
+    assert (elems != nullptr && "pointer can't be nullptr");
+
+    return list::insert_range_after (list, list->prev_arr[0], elems, count);
+}
+
+// ----------------------------------------------------------------------------
+
+list::err_t list::splice (list_t *dst, size_t dst_pos, list_t *src, size_t first, size_t last)
+{
+    assert (dst != nullptr && "pointer can't be nullptr");
+    assert (src != nullptr && "pointer can't be nullptr");
+    assert (dst->obj_size == src->obj_size && "lists have different element size");
+    list_assert (dst);
+    list_assert (src);
+    list_assert_cell (dst, dst_pos);
+    list_assert_cell (src, first);
+    list_assert_cell (src, last);
+    assert (check_index (dst, dst_pos, true)  && "invalid index");
+    assert (check_index (src, first,   false) && "invalid index");
+    assert (check_index (src, last,    false) && "invalid index");
+
+    if (dst == src)
+    {
+        relink_range (dst, dst_pos, first, last);
+        return list::OK;
+    }
+
+    size_t min_cell = 0;
+    list::err_t res = copy_range (dst, dst_pos, src, first, last, &min_cell);
+    if (res != list::OK)
+    {
+        return res;
+    }
+
+    if (src->prev_arr[first] != 0 && src->next_arr[last] != 0)
+    {
+        src->is_sorted = false;
+    }
+
+    if (min_cell < src->compact_pos)
+    {
+        src->compact_pos = min_cell;
+    }
+
+    release_range (src, first, last);
+
+    if (src->auto_shrink)
+    {
+        auto_shrink (src);
+    }
+
+    return list::OK;
+}
+
+list::err_t list::split_after (list_t *list, size_t index, list_t *tail)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+    assert (tail != nullptr && "pointer can't be nullptr");
+    assert (list != tail && "can't split into itself");
+    assert (check_index (list, index, true) && "invalid index");
+
+    if (list->next_arr[index] == 0)
+    {
+        return list::OK;
+    }
+
+    return list::splice (tail, tail->prev_arr[0], list, list->next_arr[index], list->prev_arr[0]);
+}
+
+list::err_t list::concat (list_t *dst, list_t *src)
+{
+    assert (dst != nullptr && "pointer can't be nullptr");
+    assert (src != nullptr && "pointer can't be nullptr");
+    assert (dst != src && "can't concat list with itself");
+
+    if (src->size == 0)
+    {
+        return list::OK;
+    }
+
+    return list::splice (dst, dst->prev_arr[0], src, src->next_arr[0], src->prev_arr[0]);
+}
+
+// ----------------------------------------------------------------------------
+
 void list::get (list_t *list, size_t index, void *elem)
 {
     assert (list != nullptr && "pointer can't be nullptr");
     assert (elem != nullptr && "pointer can't be nullptr");
     list_assert (list);
+    list_assert_cell (list, index);
     assert (check_index (list, index, false) && "invalid index");
 
     void *val_ptr = (char *)list->data_arr + list->obj_size * index;
@@ -311,6 +728,7 @@ void list::remove (list_t *list, size_t index, void *elem)
     assert (list != nullptr && "pointer can't be nullptr");
     assert (elem != nullptr && "pointer can't be nullptr");
     list_assert (list);
+    list_assert_cell (list, index);
     assert (check_index (list, index, false) && "invalid index");
 
     if (list->prev_arr[index] != 0 && list->next_arr[index] != 0)
@@ -318,28 +736,49 @@ void list::remove (list_t *list, size_t index, void *elem)
         list->is_sorted = false;
     }
 
-    list::get (list, index, elem);
+    memcpy (elem, (char *) list->data_arr + list->obj_size * index, list->obj_size);
+
+    _STAT (list, removes, 1);
+
+    if (list->order_index != nullptr)
+    {
+        list::order::remove (list->order_index, index);
+    }
+
     list->next_arr[list->prev_arr[index]] = list->next_arr[index];
     list->prev_arr[list->next_arr[index]] = list->prev_arr[index];
     release_free_cell (list, index);
+
+    if (index < list->compact_pos)
+    {
+        list->compact_pos = index;
+    }
+
+    if (list->compact_budget > 0)
+    {
+        compact_cells (list, list->compact_budget, nullptr);
+    }
+
+    if (list->auto_shrink)
+    {
+        auto_shrink (list);
+    }
 }
 
 void list::pop_front (list_t *list, void *elem)
 {
     assert (list != nullptr && "pointer can't be nullptr");
     assert (elem != nullptr && "pointer can't be nullptr");
-    list_assert (list);
 
-    list::remove (list, list::next (list, 0), elem);
+    list::remove (list, list->next_arr[0], elem);
 }
 
 void list::pop_back (list_t *list, void *elem)
 {
     assert (list != nullptr && "pointer can't be nullptr");
     assert (elem != nullptr && "pointer can't be nullptr");
-    list_assert (list);
 
-    list::remove (list, list::prev (list, 0), elem);
+    list::remove (list, list->prev_arr[0], elem);
 }
 
 // ----------------------------------------------------------------------------
@@ -348,6 +787,7 @@ size_t list::next (const list_t *list, size_t index)
 {
     assert (list != nullptr && "pointer can't be nullptr");
     list_assert (list);
+    list_assert_cell (list, index);
     assert (check_index (list, index, true) && "invalid index");
 
     return list->next_arr[index];
@@ -357,6 +797,7 @@ size_t list::prev (const list_t *list, size_t index)
 {
     assert (list != nullptr && "pointer can't be nullptr");
     list_assert (list);
+    list_assert_cell (list, index);
     assert (check_index (list, index, true) && "invalid index");
 
     return list->prev_arr[index];
@@ -365,7 +806,6 @@ size_t list::prev (const list_t *list, size_t index)
 size_t list::head (const list_t *list)
 {
     assert (list != nullptr && "pointer can't be nullptr");
-    list_assert (list);
 
     return list::next (list, 0);
 }
@@ -373,7 +813,6 @@ size_t list::head (const list_t *list)
 size_t list::tail (const list_t *list)
 {
     assert (list != nullptr && "pointer can't be nullptr");
-    list_assert (list);
 
     return list::prev (list, 0);
 }
@@ -386,17 +825,27 @@ size_t list::get_iter (const list_t *list, size_t index)
     list_assert (list);
     assert (index < list->size && "index out of bounds");
 
+    _STAT (list, get_iters, 1);
+
     if (list->is_sorted)
     {
         return list->next_arr[0] + index;
     }
 
-    size_t iter = list::head (list);
+    if (list->order_index != nullptr)
+    {
+        return list::order::kth (list->order_index, index);
+    }
+
+    // List is verified once above, walk links directly
+    size_t iter = list->next_arr[0];
     for (size_t i = 0; i < index; ++i)
     {
-        iter = list::next (list, iter);
+        iter = list->next_arr[iter];
     }
 
+    _STAT (list, get_iter_hops, index);
+
     #ifdef CRINGE_MODE
         if (!cringe_get_iter_wrapper (iter))
         {
@@ -410,6 +859,86 @@ size_t list::get_iter (const list_t *list, size_t index)
 
 // ----------------------------------------------------------------------------
 
+void list::visit (list_t *list, void (*func)(void *elem, void *ctx), void *ctx)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+    assert (func != nullptr && "pointer can't be nullptr");
+    list_assert (list);
+
+    char   *cells    = (char *) list->data_arr;
+    size_t  obj_size = list->obj_size;
+
+    list::detail::walk_cells (list->next_arr, list->size, list->is_sorted,
+        [cells, obj_size, func, ctx] (size_t cell, size_t ahead)
+        {
+            __builtin_prefetch (cells + ahead * obj_size);
+            func (cells + cell * obj_size, ctx);
+        });
+}
+
+// ----------------------------------------------------------------------------
+
+bool list::compact_step (list_t *list, size_t budget)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+    list_assert (list);
+
+    compact_cells (list, budget, nullptr);
+
+    return list->is_sorted;
+}
+
+void list::set_compact_budget (list_t *list, size_t budget)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+
+    list->compact_budget = budget;
+}
+
+// ----------------------------------------------------------------------------
+
+list::err_t list::enable_order_index (list_t *list)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+    list_assert (list);
+
+    if (list->order_index != nullptr)
+    {
+        return list::OK;
+    }
+
+    list->order_index = (list::order_index_t *) mem_alloc (list, sizeof (list::order_index_t));
+    UNWRAP_MALLOC (list->order_index);
+
+    list::err_t res = list::order::ctor (list->order_index, list->capacity, list->allocator);
+    if (res != list::OK)
+    {
+        mem_free (list, list->order_index, sizeof (list::order_index_t));
+        list->order_index = nullptr;
+        return res;
+    }
+
+    list::order::build (list->order_index, list);
+
+    return list::OK;
+}
+
+void list::disable_order_index (list_t *list)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+
+    if (list->order_index == nullptr)
+    {
+        return;
+    }
+
+    list::order::dtor (list->order_index);
+    mem_free (list, list->order_index, sizeof (list::order_index_t));
+    list->order_index = nullptr;
+}
+
+// ----------------------------------------------------------------------------
+
 #define _UNWRAP(expr)       \
 {                           \
     tmp_res = (expr);       \
@@ -423,670 +952,2695 @@ list::err_t list::resize (list::list_t *list, size_t new_capacity, bool linearis
 {
     assert (list != nullptr && "poointer can't be nullptr");
     list_assert (list);
-    assert (new_capacity > list->capacity && "current implementation can't shrink");
 
     list::err_t tmp_res = list::OK;
 
-    // Realloc stack
-    if (linearise)
+    if (new_capacity <= list->capacity)
     {
-        _UNWRAP (recalloc_and_sorting(list, new_capacity));
+        return shrink_cells (list, new_capacity, linearise);
     }
-    else
+
+    if (new_capacity > list::MAX_CAPACITY)
+    {
+        log (log::ERR, "Capacity %zu doesn't fit into index type (max %zu)",
+                        new_capacity, list::MAX_CAPACITY);
+        return list::CAPACITY_OVERFLOW;
+    }
+
+    if (list->order_index != nullptr)
     {
-        _UNWRAP (recalloc_no_sorting (list, new_capacity));
+        _UNWRAP (list::order::resize (list->order_index, new_capacity));
     }
 
+    // Realloc stack
+    _UNWRAP (recalloc_no_sorting (list, new_capacity));
+
     for (size_t i = list->capacity + 1; i < new_capacity + 1; ++i)
     {
-        list->prev_arr[i] = FREE_PREV;
-        list->next_arr[i] = i + 1;
+        list->prev_arr[i] = to_index (FREE_FLAG | (i - 1));
+        list->next_arr[i] = to_index (i + 1);
     }
+    list->prev_arr[list->capacity + 1] = to_index (FREE_FLAG | list->free_back);
 
     if (list->free_back != 0)
     {
-        list->next_arr[list->free_back] = list->capacity + 1;
+        list->next_arr[list->free_back] = to_index (list->capacity + 1);
     }
 
     list->next_arr[new_capacity] = 0;
-    list->free_back = new_capacity;
+    list->free_back = to_index (new_capacity);
 
     if (list->free_head == 0)
     {
-        list->free_head = list->capacity + 1;
+        list->free_head = to_index (list->capacity + 1);
     }
 
     list->capacity  = new_capacity;
 
+    if (linearise)
+    {
+        linearise_in_place (list);
+    }
+
     return list::OK;
 }
 
+list::err_t list::shrink_to_fit (list_t *list)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
 
-// ----------------------------------------------------------------------------
+    size_t new_capacity = (list->size > list->reserved) ? list->size : list->reserved;
 
-#define _UNWRAP(expr)       \
-{                           \
-    tmp_res = (expr);       \
-    if (tmp_res != list::OK)\
-    {                       \
-        return tmp_res;     \
-    }                       \
+    return list::resize (list, new_capacity);
 }
 
-list::err_t list::sort (list::list_t *list)
+void list::set_auto_shrink (list_t *list, bool enable)
 {
-    assert (list != nullptr && "poointer can't be nullptr");
-    list_assert (list);
-
-    list::err_t tmp_res = list::OK;
-
-    _UNWRAP(recalloc_and_sorting (list, list->capacity));
+    assert (list != nullptr && "pointer can't be nullptr");
 
-    return list::OK;
+    list->auto_shrink = enable;
 }
 
-
 // ----------------------------------------------------------------------------
 
-void list::dump (const list::list_t *list, FILE *stream)
+list::stats_t list::stats (const list_t *list)
 {
-    assert (list != nullptr   && "pointer can't be nullptr");
-    assert (stream != nullptr && "pointer can't be nullptr");
+    assert (list != nullptr && "pointer can't be nullptr");
+    list_assert (list);
+
+    stats_t res = {};
+
+#if LIST_STATS
+    res.ops = list->counters;
+#endif
+
+    size_t cell_bytes = list->obj_size + 2 * sizeof (index_t);
+
+    res.live_bytes     = list->size * cell_bytes;
+    res.free_bytes     = (list->capacity - list->size) * cell_bytes;
+    res.capacity_bytes = (list->capacity + 1) * cell_bytes;
+
+    size_t adjacent = 0;
+    for (size_t cell = list->next_arr[0]; cell != 0; cell = list->next_arr[cell])
+    {
+        adjacent += (list->next_arr[cell] == cell + 1);
+    }
+
+    size_t jumps = 0;
+    for (size_t cell = list->free_head; cell != 0; cell = list->next_arr[cell])
+    {
+        jumps += (list->next_arr[cell] != 0 && list->next_arr[cell] != cell + 1);
+    }
+
+    // Last element / last free cell have no successor to count
+    res.locality           = (list->size > 1) ?
+                             (double) adjacent / (double) (list->size - 1) : 1.0;
+    res.free_fragmentation = (list->capacity - list->size > 1) ?
+                             (double) jumps / (double) (list->capacity - list->size - 1) : 0.0;
+
+    return res;
+}
+
+void list::reset_stats (list_t *list)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+
+#if LIST_STATS
+    list->counters = {};
+#else
+    (void) list;
+#endif
+}
+
+
+// ----------------------------------------------------------------------------
+
+#define _UNWRAP(expr)       \
+{                           \
+    tmp_res = (expr);       \
+    if (tmp_res != list::OK)\
+    {                       \
+        return tmp_res;     \
+    }                       \
+}
+
+list::err_t list::sort (list::list_t *list, bool use_copy)
+{
+    assert (list != nullptr && "poointer can't be nullptr");
+    list_assert (list);
+
+    list::err_t tmp_res = list::OK;
+
+    if (use_copy)
+    {
+        _UNWRAP(recalloc_and_sorting (list, list->capacity));
+    }
+    else
+    {
+        linearise_in_place (list);
+    }
+
+    return list::OK;
+}
+
+void list::relink_linear (list_t *list)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+
+    relink_cells (list, 1, list->capacity + 1);
+    relink_ends  (list);
+}
+
+// ----------------------------------------------------------------------------
+
+list::err_t list::sort_parallel (list_t *list, size_t threads)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+    list_assert (list);
+
+    if (list->is_sorted && (list->size == 0 || list->next_arr[0] == 1))
+    {
+        return list::OK;
+    }
+
+    if (threads == 0 && list->size >= PARALLEL_MIN_SIZE)
+    {
+        threads = std::thread::hardware_concurrency ();
+    }
+
+    // Thread start-up costs more than a short walk
+    if (threads <= 1 || list->size < PARALLEL_MIN_SIZE)
+    {
+        return list::sort (list, true);
+    }
+
+    list::err_t res = linearise_parallel (list, threads);
+
+    list_assert (list);
+
+    return res;
+}
+
+// ----------------------------------------------------------------------------
+
+list::err_t list::sort_by (list_t *list, int (*cmp)(const void *a, const void *b), bool linearise)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+    assert (cmp  != nullptr && "pointer can't be nullptr");
+    list_assert (list);
+
+    // Binary counter of runs: runs[i] holds 2^i elements and is earlier in
+    // the list than runs[i - 1], so merging keeps equal elements in order
+    size_t runs[64] = {};
+
+    size_t cell = list->next_arr[0];
+    while (cell != 0)
+    {
+        size_t next = list->next_arr[cell];
+        list->next_arr[cell] = 0;
+
+        size_t run = cell;
+        size_t i   = 0;
+        for (; runs[i] != 0; ++i)
+        {
+            run     = merge_runs (list, runs[i], run, cmp);
+            runs[i] = 0;
+        }
+        runs[i] = run;
+
+        cell = next;
+    }
+
+    size_t head = 0;
+    for (size_t i = 0; i < 64; ++i)
+    {
+        if (runs[i] != 0)
+        {
+            head = (head == 0) ? runs[i] : merge_runs (list, runs[i], head, cmp);
+        }
+    }
+
+    list->next_arr[0] = to_index (head);
+    relink_prev (list);
+
+    finish_value_sort (list, linearise);
+
+    return list::OK;
+}
+
+// ----------------------------------------------------------------------------
+
+list::err_t list::sort_by_key (list_t *list, uint64_t (*key)(const void *elem), bool linearise)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+    assert (key  != nullptr && "pointer can't be nullptr");
+    list_assert (list);
+
+    size_t count = list->size;
+
+    // One histogram per key byte, all filled in the gathering walk
+    size_t counts_size = 8 * sizeof (size_t [256]);
+    size_t keys_size   = (2 * count + 1) * sizeof (sort_key_t);
+
+    size_t (*counts)[256] = (size_t (*)[256]) mem_alloc (list, counts_size);
+    UNWRAP_MALLOC (counts);
+    memset (counts, 0, counts_size);
+
+    sort_key_t *keys = (sort_key_t *) mem_alloc (list, keys_size);
+    if (keys == nullptr)
+    {
+        mem_free (list, counts, counts_size);
+        log (log::ERR, "OOM");
+        return list::OOM;
+    }
+
+    sort_key_t *tmp  = keys + count;
+    const char *data = (const char *) list->data_arr;
+
+    size_t cell = list->next_arr[0];
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint64_t elem_key = key (data + cell * list->obj_size);
+
+        keys[i] = {elem_key, cell};
+        for (size_t byte = 0; byte < 8; ++byte)
+        {
+            counts[byte][(elem_key >> (byte * 8)) & 0xFF]++;
+        }
+
+        cell = list->next_arr[cell];
+    }
+
+    // LSD passes are stable, a byte equal in every key is skipped
+    for (size_t byte = 0; byte < 8; ++byte)
+    {
+        if (count == 0 || counts[byte][(keys[0].key >> (byte * 8)) & 0xFF] == count)
+        {
+            continue;
+        }
+
+        radix_pass (keys, tmp, count, counts[byte], byte * 8);
+        std::swap (keys, tmp);
+    }
+
+    size_t prev = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        list->next_arr[prev]         = to_index (keys[i].cell);
+        list->prev_arr[keys[i].cell] = to_index (prev);
+        prev = keys[i].cell;
+    }
+    list->next_arr[prev] = 0;
+    list->prev_arr[0]    = to_index (prev);
+
+    mem_free (list, (keys < tmp) ? keys : tmp, keys_size);
+    mem_free (list, counts, counts_size);
+
+    finish_value_sort (list, linearise);
+
+    return list::OK;
+}
+
+// ----------------------------------------------------------------------------
+
+list::err_t list::save (const list_t *list, FILE *stream, bool raw)
+{
+    assert (list   != nullptr && "pointer can't be nullptr");
+    assert (stream != nullptr && "pointer can't be nullptr");
+    list_assert (list);
+
+    snapshot_header_t header = {};
+    memcpy (header.magic, SNAPSHOT_MAGIC, sizeof (SNAPSHOT_MAGIC));
+
+    header.version    = SNAPSHOT_VERSION;
+    header.index_bits = LIST_INDEX_BITS;
+    header.obj_size   = list->obj_size;
+    header.capacity   = raw ? list->capacity  : list->size;
+    header.size       = list->size;
+    header.free_head  = raw ? list->free_head : 0;
+    header.free_back  = raw ? list->free_back : 0;
+    header.mode       = raw ? SNAPSHOT_RAW    : SNAPSHOT_LINEAR;
+    header.is_sorted  = raw ? list->is_sorted : true;
+    header.header_sum = checksum (&header, offsetof (snapshot_header_t, header_sum));
+
+    if (fwrite (&header, sizeof (header), 1, stream) != 1)
+    {
+        log (log::ERR, "Failed to write snapshot header");
+        return list::IO_ERROR;
+    }
+
+    list::err_t tmp_res = list::OK;
+
+    if (raw)
+    {
+        _UNWRAP (write_blocks (stream, list->data_arr, list->obj_size,         list->capacity + 1));
+        _UNWRAP (write_blocks (stream, list->next_arr, sizeof (list::index_t), list->capacity + 1));
+        _UNWRAP (write_blocks (stream, list->prev_arr, sizeof (list::index_t), list->capacity + 1));
+
+        return list::OK;
+    }
+
+    // Linearised storage is already in logical order
+    if (list->is_sorted && (list->size == 0 || list->next_arr[0] == 1))
+    {
+        return write_blocks (stream, (char *) list->data_arr + list->obj_size,
+                             list->obj_size, list->size);
+    }
+
+    size_t block_elems = SNAPSHOT_BLOCK / list->obj_size + 1;
+    char  *block       = (char *) mem_alloc (list, block_elems * list->obj_size);
+    if (block == nullptr)
+    {
+        log (log::ERR, "OOM");
+        return list::OOM;
+    }
+
+    size_t index = list->next_arr[0];
+    for (size_t done = 0; done < list->size && tmp_res == list::OK; )
+    {
+        size_t count = list->size - done;
+        if (count > block_elems)
+        {
+            count = block_elems;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            memcpy (block + i * list->obj_size,
+                    (char *) list->data_arr + index * list->obj_size, list->obj_size);
+            index = list->next_arr[index];
+        }
+
+        tmp_res = write_block (stream, block, list->obj_size, count);
+        done   += count;
+    }
+
+    mem_free (list, block, block_elems * list->obj_size);
+
+    return tmp_res;
+}
+
+list::err_t list::load (list_t *list, FILE *stream, size_t obj_size,
+                        void (*print_func)(void *elem, FILE *stream),
+                        const allocator_t *allocator)
+{
+    assert (list       != nullptr && "pointer can't be nullptr");
+    assert (stream     != nullptr && "pointer can't be nullptr");
+    assert (print_func != nullptr && "pointer can't be nullptr");
+
+    snapshot_header_t header = {};
+    if (fread (&header, sizeof (header), 1, stream) != 1)
+    {
+        log (log::ERR, "Failed to read snapshot header");
+        return list::IO_ERROR;
+    }
+
+    if (memcmp (header.magic, SNAPSHOT_MAGIC, sizeof (SNAPSHOT_MAGIC)) != 0 ||
+        header.version    != SNAPSHOT_VERSION)
+    {
+        log (log::ERR, "Bad snapshot header");
+        return list::BAD_FORMAT;
+    }
+
+    if (header.header_sum != checksum (&header, offsetof (snapshot_header_t, header_sum)))
+    {
+        log (log::ERR, "Snapshot header checksum mismatch");
+        return list::BAD_FORMAT;
+    }
+
+    // Capacity is checked before ctor allocates for it
+    if (header.index_bits != LIST_INDEX_BITS    ||
+        header.capacity   >  list::MAX_CAPACITY ||
+        header.obj_size   != obj_size           ||
+        header.mode > SNAPSHOT_RAW              ||
+        header.size > header.capacity           ||
+        header.free_head > header.capacity      ||
+        header.free_back > header.capacity)
+    {
+        log (log::ERR, "Bad snapshot header");
+        return list::BAD_FORMAT;
+    }
+
+    list::err_t tmp_res = list::ctor (list, obj_size, header.capacity, print_func, allocator);
+    if (tmp_res != list::OK)
+    {
+        return tmp_res;
+    }
+
+    if (header.mode == SNAPSHOT_LINEAR)
+    {
+        // One fread per block straight into cells [1, size]
+        tmp_res = read_blocks (stream, (char *) list->data_arr + obj_size, obj_size, header.size);
+        if (tmp_res == list::OK)
+        {
+            list->size = header.size;
+            relink_linear (list);
+        }
+    }
+    else
+    {
+        tmp_res = read_blocks (stream, list->data_arr, obj_size, header.capacity + 1);
+        if (tmp_res == list::OK)
+            tmp_res = read_blocks (stream, list->next_arr, sizeof (list::index_t), header.capacity + 1);
+        if (tmp_res == list::OK)
+            tmp_res = read_blocks (stream, list->prev_arr, sizeof (list::index_t), header.capacity + 1);
+
+        if (tmp_res == list::OK)
+        {
+            _Pragma ("GCC diagnostic push")
+            _Pragma ("GCC diagnostic ignored \"-Wuseless-cast\"")
+            list->free_head = (list::index_t) header.free_head;
+            list->free_back = (list::index_t) header.free_back;
+            _Pragma ("GCC diagnostic pop")
+
+            list->size        = header.size;
+            list->is_sorted   = false;
+            list->compact_pos = 1;
+
+            // Checksums catch corruption in transit, verify catches broken producers
+            if (list::verify (list) != list::OK)
+            {
+                log (log::ERR, "Snapshot links don't form a valid list");
+                tmp_res = list::BAD_FORMAT;
+            }
+            else
+            {
+                // Header flag is not trusted: sorted list must be one contiguous run
+                size_t cell = list->next_arr[0];
+                size_t run  = 1;
+                while (run < list->size && list->next_arr[cell] == cell + 1)
+                {
+                    cell++;
+                    run++;
+                }
+
+                list->is_sorted = list->size == 0 || run == list->size;
+            }
+        }
+    }
+
+    if (tmp_res != list::OK)
+    {
+        // Reset to valid empty list, so dtor doesn't report garbage links
+        list->size = 0;
+        relink_linear (list);
+        list::dtor (list);
+        return tmp_res;
+    }
+
+    // Capacity came from the snapshot, not from the caller
+    list->reserved = 0;
+
+    return list::OK;
+}
+
+// ----------------------------------------------------------------------------
+
+void list::dump (const list::list_t *list, FILE *stream, const dump_window_t *window)
+{
+    assert (list != nullptr   && "pointer can't be nullptr");
+    assert (stream != nullptr && "pointer can't be nullptr");
+
+    list::dump_window_t current = {};
+    if (window == nullptr)
+    {
+        std::lock_guard<std::mutex> lock (dumps.mutex);
+        current = dumps.window;
+        window  = &current;
+    }
+
+    dump_capture_t *capture = capture_dump (list, window);
+    if (capture == nullptr)
+    {
+        log (log::ERR, "OOM, dump is skipped");
+        return;
+    }
+
+    fprintf (stream, "List dump:\n");
+
+    fprintf (stream, "\tfree_head: %" LIST_IDX_FMT "\n", list->free_head);
+    fprintf (stream, "\tobj_size:  %zu\n", list->obj_size);
+    fprintf (stream, "\treserved:  %zu\n", list->reserved);
+    fprintf (stream, "\tcapacity:  %zu\n", list->capacity);
+    fprintf (stream, "\tsize:      %zu\n", list->size);
+    fprintf (stream, "\tshown:     %zu\n", capture->n_cells);
+
+    fprintf (stream, "%8s %8s %8s  %s\n", "INDX", "PREV", "NEXT", "DATA");
+
+    size_t gap = 0;
+    for (size_t pos = 0; pos < capture->n_cells; ++pos)
+    {
+        const dump_cell_t *cell = &capture->cells[pos];
+
+        fprintf (stream, "%8zu ", cell->index);
+
+        if (cell->state == DUMP_CELL_FREE)
+        {
+            fprintf (stream, "%8s %8zu  F", "F", cell->next);
+        }
+        else
+        {
+            fprintf (stream, "%8zu %8zu  ", cell->prev, cell->next);
+
+            if (cell->index == 0)
+            {
+                fprintf (stream, "nil");
+            }
+            else
+            {
+                list->print_func (capture->data + pos * list->obj_size, stream);
+            }
+        }
+
+        fputs ((cell->state == DUMP_CELL_INVALID) ? "  <- broken\n" : "\n", stream);
+
+        if (gap < capture->n_gaps && capture->gaps[gap].first == cell->index + 1)
+        {
+            const dump_gap_t *skipped = &capture->gaps[gap++];
+
+            fprintf (stream, "     ... cells %zu..%zu skipped: %zu live, %zu free\n",
+                     skipped->first, skipped->last, skipped->live, skipped->free);
+        }
+    }
+
+    free_capture (capture);
+}
+
+// ----------------------------------------------------------------------------
+
+void list::graph_dump (const list::list_t *list, const char *reason_fmt, ...)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+
+    static std::atomic<int> counter (0);
+
+    dump_job_t job = {};
+    job.number = ++counter;
+
+    va_list args;
+    va_start (args, reason_fmt);
+    vsnprintf (job.reason, DUMP_REASON_LEN, reason_fmt, args);
+    va_end (args);
+
+    std::unique_lock<std::mutex> lock (dumps.mutex);
+    list::dump_window_t window = dumps.window;
+    lock.unlock ();
+
+    job.capture = capture_dump (list, &window);
+    if (job.capture == nullptr)
+    {
+        log (log::ERR, "OOM, dump '%s' is skipped", job.reason);
+        return;
+    }
+
+    lock.lock ();
+    dumps.stats.requested++;
+
+    if (dumps.workers == 0)
+    {
+        lock.unlock ();
+        render_dump (&job);
+        return;
+    }
+
+    // Workers start lazily, so programs that never dump don't get threads
+    while (dumps.threads.size () < dumps.workers)
+    {
+        dumps.threads.emplace_back (dump_worker);
+    }
+
+    if (!dumps.at_exit)
+    {
+        atexit (stop_dump_workers);
+        dumps.at_exit = true;
+    }
+
+    enqueue_dump (&job);
+}
+
+// ----------------------------------------------------------------------------
+
+void list::set_dump_workers (size_t workers)
+{
+    stop_dump_workers ();
+
+    std::lock_guard<std::mutex> lock (dumps.mutex);
+    dumps.workers = workers;
+}
+
+void list::set_dump_window (dump_window_t window)
+{
+    std::lock_guard<std::mutex> lock (dumps.mutex);
+    dumps.window = window;
+}
+
+void list::set_dump_limits (size_t max_pending, size_t min_interval_ms)
+{
+    std::lock_guard<std::mutex> lock (dumps.mutex);
+
+    dumps.max_pending = (max_pending > 0) ? max_pending : 1;
+    dumps.interval_ms = min_interval_ms;
+}
+
+void list::graph_dump_flush ()
+{
+    std::unique_lock<std::mutex> lock (dumps.mutex);
+
+    dumps.done_cv.wait (lock, [] { return dumps.queue.empty () && dumps.in_flight == 0; });
+}
+
+list::dump_stats_t list::graph_dump_stats ()
+{
+    std::lock_guard<std::mutex> lock (dumps.mutex);
+
+    return dumps.stats;
+}
+
+// ----------------------------------------------------------------------------
+
+const char *list::err_to_str (const list::err_t err)
+{
+    switch (err)
+    {
+        case list::OK:
+            return "OK";
+
+        case list::OOM:
+            return "Out Of Memory";
+
+        case list::EMPTY:
+            return "List is empty";
+
+        case list::NULLPTR:
+            return "List pointer is nullptr";
+
+        case list::INVALID_CAPACITY:
+            return "Invalid capacity";
+
+        case list::INVALID_SIZE:
+            return "Invalid size";
+
+        case list::BROKEN_DATA_LOOP:
+            return "Broken data loop";
+
+        case list::BROKEN_FREE_LOOP:
+            return "Broken free loop";
+
+        case list::CAPACITY_OVERFLOW:
+            return "Capacity doesn't fit into index type";
+
+        case list::IO_ERROR:
+            return "I/O error";
+
+        case list::BAD_FORMAT:
+            return "Bad file format";
+
+        default:
+            assert (0 && "Unexpected error code");
+    }
+}
+
+// ----------------------------------------------------------------------------
+// STATIC FUNCTIONS
+// ----------------------------------------------------------------------------
+
+// Takes free cell nearest to hint, grows storage when there is none
+static ssize_t get_free_cell (list::list_t *list, size_t hint)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+
+    list::err_t res = list::OK;
+
+    // If we need reallocation
+    if (list->free_head == 0) 
+    {
+        if (list->capacity == list::MAX_CAPACITY)
+        {
+            log (log::ERR, "List is full: index type allows only %zu cells", list::MAX_CAPACITY);
+            return ERROR;
+        }
+
+        if (list->capacity == 0)
+        {
+            res = list::resize (list, 1);
+        }
+        else if (list->capacity > list::MAX_CAPACITY / 2)
+        {
+            res = list::resize (list, list::MAX_CAPACITY);
+        }
+        else
+        {
+            res = list::resize (list, list->capacity * 2);
+        }
+
+
+        if (res != list::OK)
+        {
+            log (log::ERR, "Failed to reallocate with error '%s'", list::err_to_str (res));
+            return ERROR;
+        }
+    }
+
+    size_t free_index = nearest_free_cell (list, hint);
+
+    unlink_free_cell (list, free_index);
+
+    list->size++;
+    _STAT (list, inserts, 1);
+
+    return (ssize_t) free_index;
+}
+
+// Free list is doubly linked, so any free cell can be taken in O(1). Tags in
+// prev_arr of the cells around hint are checked (a couple of cache lines),
+// hint itself and cells after it first; LIFO free head is the fallback.
+static size_t nearest_free_cell (const list::list_t *list, size_t hint)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+    assert (list->free_head != 0 && "no free cells");
+
+    for (size_t dist = 0; dist <= LOCAL_PROBE; ++dist)
+    {
+        size_t after = hint + dist;
+        if (after >= 1 && after <= list->capacity && is_free_cell (list, after))
+        {
+            return after;
+        }
+
+        if (dist != 0 && hint > dist && hint - dist <= list->capacity &&
+            is_free_cell (list, hint - dist))
+        {
+            return hint - dist;
+        }
+    }
+
+    return list->free_head;
+}
+
+// ----------------------------------------------------------------------------
+
+// Claims count cells (contiguous after index if possible) and splices them in once
+static list::err_t insert_run (list::list_t *list, size_t index, const void *elems,
+                               size_t count, size_t *first_res)
+{
+    assert (list      != nullptr && "pointer can't be nullptr");
+    assert (elems     != nullptr && "pointer can't be nullptr");
+    assert (first_res != nullptr && "pointer can't be nullptr");
+    assert (count > 0 && "empty run");
+
+    // Reserve once: appending to linearised list wants cells right after index
+    bool append_run = list->is_sorted && index == list->prev_arr[0] &&
+                      index + count <= list::MAX_CAPACITY;
+
+    list::err_t res = list::OOM;
+    if (append_run)
+    {
+        res = reserve_cells (list, index + count);
+    }
+
+    // Run can't be placed after index: free list path only needs size + count
+    if (res != list::OK)
+    {
+        res = reserve_cells (list, list->size + count);
+    }
+
+    if (res != list::OK)
+    {
+        return res;
+    }
+
+    const char *src = (const char *) elems;
+    char *data      = (char *) list->data_arr;
+    size_t obj      = list->obj_size;
+
+    size_t old_next = list->next_arr[index];
+    size_t first    = 0;
+    size_t last     = 0;
+
+    if (is_free_run (list, index + 1, count))
+    {
+        for (size_t i = index + 1; i <= index + count; ++i)
+        {
+            unlink_free_cell (list, i);
+            list->prev_arr[i] = to_index (i - 1);
+            list->next_arr[i] = to_index (i + 1);
+        }
+
+        memcpy (data + (index + 1) * obj, src, count * obj);
+
+        if (old_next != 0 && old_next != index + count + 1)
+        {
+            list->is_sorted = false;
+        }
+
+        first = index + 1;
+        last  = index + count;
+    }
+    else
+    {
+        list->is_sorted = false;
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            size_t cell = list->free_head;
+            unlink_free_cell (list, cell);
+
+            memcpy (data + cell * obj, src + i * obj, obj);
+
+            if (last != 0)
+            {
+                list->next_arr[last] = to_index (cell);
+                list->prev_arr[cell] = to_index (last);
+            }
+            else
+            {
+                first = cell;
+            }
+
+            last = cell;
+        }
+    }
+
+    // Single splice of [first, last] between index and old_next
+    list->prev_arr[first]    = to_index (index);
+    list->next_arr[index]    = to_index (first);
+    list->next_arr[last]     = to_index (old_next);
+    list->prev_arr[old_next] = to_index (last);
+
+    list->size += count;
+    _STAT (list, inserts, count);
+
+    if (list->order_index != nullptr)
+    {
+        for (size_t cell = first, prev = index; prev != last; prev = cell, cell = list->next_arr[cell])
+        {
+            list::order::insert_after (list->order_index, prev, cell);
+        }
+    }
+
+    if (index + 1 < list->compact_pos)
+    {
+        list->compact_pos = index + 1;
+    }
+
+    *first_res = first;
+    return list::OK;
+}
+
+// ----------------------------------------------------------------------------
+
+// Copies src range into dst after dst_pos, physically contiguous pieces go in one run
+static list::err_t copy_range (list::list_t *dst, size_t dst_pos, const list::list_t *src,
+                               size_t first, size_t last, size_t *min_cell)
+{
+    assert (dst      != nullptr && "pointer can't be nullptr");
+    assert (src      != nullptr && "pointer can't be nullptr");
+    assert (min_cell != nullptr && "pointer can't be nullptr");
+
+    size_t count = 1;
+    for (size_t cell = first; cell != last; cell = src->next_arr[cell])
+    {
+        assert (src->next_arr[cell] != 0 && "last is not reachable from first");
+        count++;
+    }
+
+    // Reserve for both insert_run paths once, src is untouched if it fails
+    list::err_t res = list::OOM;
+    if (dst->is_sorted && dst_pos == dst->prev_arr[0] && dst_pos + count <= list::MAX_CAPACITY)
+    {
+        res = reserve_cells (dst, dst_pos + count);
+    }
+
+    if (res != list::OK)
+    {
+        res = reserve_cells (dst, dst->size + count);
+    }
+
+    if (res != list::OK)
+    {
+        return res;
+    }
+
+    const char *data = (const char *) src->data_arr;
+    size_t run_start = first;
+    size_t run_len   = 1;
+    size_t pos       = dst_pos;
+
+    *min_cell = first;
+
+    for (size_t cell = first; ; cell = src->next_arr[cell])
+    {
+        if (cell < *min_cell)
+        {
+            *min_cell = cell;
+        }
+
+        size_t next = src->next_arr[cell];
+
+        if (cell != last && next == cell + 1)
+        {
+            run_len++;
+            continue;
+        }
+
+        size_t pos_next  = dst->next_arr[pos];
+        size_t run_first = 0;
+        res = insert_run (dst, pos, data + run_start * src->obj_size, run_len, &run_first);
+        if (res != list::OK)
+        {
+            return res;
+        }
+
+        pos = dst->prev_arr[pos_next];
+
+        if (cell == last)
+        {
+            break;
+        }
+
+        run_start = next;
+        run_len   = 1;
+    }
+
+    return list::OK;
+}
+
+// ----------------------------------------------------------------------------
+
+// Unlinks [first, last] and pushes the whole chain to free list with one splice
+static void release_range (list::list_t *list, size_t first, size_t last)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+
+    if (list->order_index != nullptr)
+    {
+        list::order::remove_range (list->order_index, first, last);
+    }
+
+    size_t before = list->prev_arr[first];
+    size_t after  = list->next_arr[last];
+
+    list->next_arr[before] = to_index (after);
+    list->prev_arr[after]  = to_index (before);
+
+    size_t prev = 0;
+    for (size_t cell = first; ; cell = list->next_arr[cell])
+    {
+        list->prev_arr[cell] = to_index (FREE_FLAG | prev);
+        list->size--;
+        _STAT (list, removes, 1);
+        prev = cell;
+
+        if (cell == last)
+        {
+            break;
+        }
+    }
+
+    list->next_arr[last] = list->free_head;
+    if (list->free_head != 0)
+    {
+        list->prev_arr[list->free_head] = to_index (FREE_FLAG | last);
+    }
+    else
+    {
+        list->free_back = to_index (last);
+    }
+    list->free_head = to_index (first);
+}
+
+// ----------------------------------------------------------------------------
+
+static void relink_range (list::list_t *list, size_t dst_pos, size_t first, size_t last)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+
+    #ifndef NDEBUG
+        for (size_t cell = first; ; cell = list->next_arr[cell])
+        {
+            assert (cell != 0 && "last is not reachable from first");
+            assert (cell != dst_pos && "destination is inside the range");
+
+            if (cell == last) break;
+        }
+    #endif
+
+    size_t before = list->prev_arr[first];
+    size_t after  = list->next_arr[last];
+
+    if (before == dst_pos)
+    {
+        return;
+    }
+
+    if (list->order_index != nullptr)
+    {
+        list::order::move_range (list->order_index, first, last, dst_pos);
+    }
+
+    list->next_arr[before] = to_index (after);
+    list->prev_arr[after]  = to_index (before);
+
+    size_t old_next = list->next_arr[dst_pos];
+
+    list->next_arr[dst_pos]  = to_index (first);
+    list->prev_arr[first]    = to_index (dst_pos);
+    list->next_arr[last]     = to_index (old_next);
+    list->prev_arr[old_next] = to_index (last);
+
+    list->is_sorted = false;
+
+    size_t min_cell = (first < dst_pos + 1) ? first : dst_pos + 1;
+    if (min_cell < list->compact_pos)
+    {
+        list->compact_pos = min_cell;
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+// Moves live cells to [1, size] and cuts arrays down to new_capacity
+static list::err_t shrink_cells (list::list_t *list, size_t new_capacity, bool linearise)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+    assert (new_capacity <= list->capacity && "not a shrink");
+
+    list::err_t tmp_res = list::OK;
+
+    if (new_capacity < list->size)
+    {
+        log (log::ERR, "Can't shrink list with %zu elements to capacity %zu",
+                        list->size, new_capacity);
+        return list::INVALID_CAPACITY;
+    }
+
+    if (new_capacity < list->reserved)
+    {
+        log (log::ERR, "Can't shrink list below reserved capacity %zu to %zu",
+                        list->reserved, new_capacity);
+        return list::INVALID_CAPACITY;
+    }
+
+    if (new_capacity == list->capacity)
+    {
+        if (linearise)
+        {
+            linearise_in_place (list);
+        }
+
+        return list::OK;
+    }
+
+    // Linear storage is skipped by linearise_in_place even when its free
+    // chain is shuffled (pops, compaction), so the chain is rebuilt anyway
+    linearise_in_place (list);
+    relink_linear (list);
+
+    // Cells above new_capacity are free now, so failed realloc leaves list intact
+    _UNWRAP (recalloc_no_sorting (list, new_capacity));
+
+    // Free cells are [size + 1, capacity] in order, cut the tail off
+    if (list->size < new_capacity)
+    {
+        list->next_arr[new_capacity] = 0;
+        list->free_back = to_index (new_capacity);
+    }
+    else
+    {
+        list->free_head = 0;
+        list->free_back = 0;
+    }
+
+    list->capacity = new_capacity;
+
+    if (list->order_index != nullptr)
+    {
+        _UNWRAP (list::order::resize (list->order_index, new_capacity));
+    }
+
+    return list::OK;
+}
+
+// ----------------------------------------------------------------------------
+
+// Growth doubles on full list, shrink halves on quarter load: after either
+// resize the list is half full, so at least capacity/4 operations separate them
+static void auto_shrink (list::list_t *list)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+
+    if (list->capacity <= list->reserved || list->size > list->capacity / SHRINK_LOAD)
+    {
+        return;
+    }
+
+    size_t new_capacity = list->capacity / 2;
+    if (new_capacity < list->reserved)
+    {
+        new_capacity = list->reserved;
+    }
+
+    list::err_t res = shrink_cells (list, new_capacity, false);
+    if (res != list::OK)
+    {
+        log (log::WRN, "Failed to shrink list with error '%s'", list::err_to_str (res));
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+static list::err_t reserve_cells (list::list_t *list, size_t min_capacity)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+
+    if (min_capacity <= list->capacity)
+    {
+        return list::OK;
+    }
+
+    size_t new_capacity = list->capacity * 2;
+
+    if (new_capacity < min_capacity)                                            new_capacity = min_capacity;
+    if (new_capacity > list::MAX_CAPACITY && min_capacity <= list::MAX_CAPACITY) new_capacity = list::MAX_CAPACITY;
+
+    list::err_t res = list::resize (list, new_capacity);
+    if (res != list::OK)
+    {
+        log (log::ERR, "Failed to reserve %zu cells with error '%s'", min_capacity, list::err_to_str (res));
+    }
+
+    return res;
+}
+
+static bool is_free_run (const list::list_t *list, size_t from, size_t count)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+
+    if (from + count - 1 > list->capacity)
+    {
+        return false;
+    }
+
+    for (size_t i = from; i < from + count; ++i)
+    {
+        if (!is_free_cell (list, i))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+
+static void release_free_cell (list::list_t *list, size_t index)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+    assert (check_index (list, index, false) && "invalid index");
+
+    list->next_arr[index] = list->free_head;
+    list->prev_arr[index] = FREE_FLAG;
+
+    if (list->free_head != 0)
+    {
+        list->prev_arr[list->free_head] = to_index (FREE_FLAG | index);
+    }
+    else
+    {
+        list->free_back = to_index (index);
+    }
+
+    list->free_head = to_index (index);
+    list->size--;
+}
+
+static void unlink_free_cell (list::list_t *list, size_t index)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+    assert (is_free_cell (list, index) && "cell is not free");
+
+    size_t free_prev = list->prev_arr[index] & INDEX_MASK;
+    size_t free_next = list->next_arr[index];
+
+    if (free_prev != 0) { list->next_arr[free_prev] = to_index (free_next); }
+    else                { list->free_head           = to_index (free_next); }
+
+    if (free_next != 0) { list->prev_arr[free_next] = to_index (FREE_FLAG | free_prev); }
+    else                { list->free_back           = to_index (free_prev); }
+}
+
+static inline bool is_free_cell (const list::list_t *list, size_t index)
+{
+    return (list->prev_arr[index] & FREE_FLAG) != 0;
+}
+
+// ----------------------------------------------------------------------------
+
+// Invariant: cells [1, compact_pos) hold first compact_pos - 1 elements in order.
+// Each step puts next element into cell compact_pos by moving or swapping it.
+static size_t compact_cells (list::list_t *list, size_t budget, size_t *tracked)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+
+    size_t done = 0;
+
+    while (!list->is_sorted && done < budget)
+    {
+        size_t pos = list->compact_pos;
+
+        if (pos > list->size)
+        {
+            list->is_sorted = true;
+            break;
+        }
+
+        size_t cell = list->next_arr[pos - 1];
+
+        if (cell != pos)
+        {
+            if (is_free_cell (list, pos))
+            {
+                move_cell (list, cell, pos);
+            }
+            else
+            {
+                swap_cells (list, cell, pos);
+            }
+
+            if (tracked != nullptr)
+            {
+                if      (*tracked == cell) { *tracked = pos;  }
+                else if (*tracked == pos)  { *tracked = cell; }
+            }
+        }
+
+        list->compact_pos++;
+        done++;
+    }
+
+    if (list->compact_pos > list->size)
+    {
+        list->is_sorted = true;
+    }
+
+    return done;
+}
+
+// ----------------------------------------------------------------------------
+
+static void move_cell (list::list_t *list, size_t from, size_t to)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+    assert (!is_free_cell (list, from) && is_free_cell (list, to) && "invalid move");
+
+    unlink_free_cell (list, to);
+
+    memcpy ((char *) list->data_arr + to   * list->obj_size,
+            (char *) list->data_arr + from * list->obj_size, list->obj_size);
+
+    size_t prev = list->prev_arr[from];
+    size_t next = list->next_arr[from];
+
+    list->prev_arr[to]   = to_index (prev);
+    list->next_arr[to]   = to_index (next);
+    list->next_arr[prev] = to_index (to);
+    list->prev_arr[next] = to_index (to);
+
+    if (list->order_index != nullptr)
+    {
+        list::order::move (list->order_index, from, to);
+    }
+
+    // Cell keeps its size accounting, only physical place changes
+    list->size++;
+    release_free_cell (list, from);
+}
+
+static void swap_cells (list::list_t *list, size_t a, size_t b)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+    assert (a != 0 && b != 0 && a != b && "invalid swap");
+
+    // Null cell payload is never read, use it as scratch
+    char *data    = (char *) list->data_arr;
+    char *scratch = data;
+    size_t obj    = list->obj_size;
+
+    memcpy (scratch,       data + a * obj, obj);
+    memcpy (data + a * obj, data + b * obj, obj);
+    memcpy (data + b * obj, scratch,       obj);
+
+    #define _MAP(x) ((x) == a ? b : ((x) == b ? a : (x)))
+
+    size_t prev_a = _MAP (list->prev_arr[a]);
+    size_t next_a = _MAP (list->next_arr[a]);
+    size_t prev_b = _MAP (list->prev_arr[b]);
+    size_t next_b = _MAP (list->next_arr[b]);
+
+    #undef _MAP
+
+    list->prev_arr[b] = to_index (prev_a);
+    list->next_arr[b] = to_index (next_a);
+    list->prev_arr[a] = to_index (prev_b);
+    list->next_arr[a] = to_index (next_b);
+
+    list->next_arr[list->prev_arr[a]] = to_index (a);
+    list->prev_arr[list->next_arr[a]] = to_index (a);
+    list->next_arr[list->prev_arr[b]] = to_index (b);
+    list->prev_arr[list->next_arr[b]] = to_index (b);
+
+    if (list->order_index != nullptr)
+    {
+        list::order::swap (list->order_index, a, b);
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+#define _ERR_CASE(cond, msg)                        \
+{                                                   \
+    if (cond)                                       \
+    {                                               \
+        log (log::DBG, "Invalid index (%s)", msg);  \
+        return false;                               \
+    }                                               \
+}
+
+static bool check_index (const list::list_t *list, size_t index, bool can_be_zero)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+
+    _ERR_CASE (!can_be_zero && index == 0, "null");
+    _ERR_CASE (index > list->capacity, "out of bounds");
+    _ERR_CASE (is_free_cell (list, index), "points to free cell");
+
+    return true;
+}
+
+#undef _ERR_CASE
+
+// ----------------------------------------------------------------------------
+
+static bool check_cell (const list::list_t *list, size_t index)
+{
+    assert (list != nullptr && "pointer can't be null");
+
+    if (!check_index (list, index, false))
+    {
+        log (log::DBG, "current index is incorrect");
+        return false;
+    }
+
+    if (is_free_cell (list, index))
+    {
+        log (log::ERR, "Free cell");
+        return false;
+    }
+
+    if (!check_index (list, list->next_arr[index], true))
+    {
+        log (log::ERR, "next index is incorrect");
+        return false;
+    }
+
+    if (!check_index (list, list->prev_arr[index], true))
+    {
+        log (log::ERR, "prev index is incorrect");
+        return false;
+    }
+
+    if (list->next_arr[list->prev_arr[index]] != index)
+    {
+        log (log::ERR, "next[prev[index]] != index");
+        return false;
+    }
+
+    if (list->prev_arr[list->next_arr[index]] != index)
+    {
+        log (log::ERR, "prev[next[index]] != index");
+        return false;
+    }
+
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+
+// Silent O(1) version of check_cell, null cell is allowed
+static bool check_links (const list::list_t *list, size_t index)
+{
+    assert (list != nullptr && "pointer can't be null");
+
+    size_t next = list->next_arr[index];
+    size_t prev = list->prev_arr[index];
+
+    return next <= list->capacity && prev <= list->capacity &&
+           !is_free_cell (list, next) && !is_free_cell (list, prev) &&
+           list->next_arr[prev] == index && list->prev_arr[next] == index;
+}
+
+// ----------------------------------------------------------------------------
+
+static void verify_data_loop  (const list::list_t *list, list::err_flags *flags)
+{
+    assert (list  != nullptr && "pointer can't be nullptr");
+    assert (flags != nullptr && "pointer can't be nullptr");
+
+    size_t index = list->next_arr[0];
+
+    if (!check_index (list, index, true))
+    {
+        *flags |= list::BROKEN_DATA_LOOP;
+        return;
+    }
+
+    if (*flags == list::OK && list->size > 0)
+    {
+        for (size_t i = 0; i < list->size - 1; ++i)
+        {
+            if (check_cell (list, index))
+            {
+                index = list->next_arr[index];
+            }
+            else
+            {
+                log (log::ERR, "Broken cell");
+                *flags |= list::BROKEN_DATA_LOOP;
+                return;
+            }
+        }
+    }
+
+    if (list->next_arr[index] != 0)
+    {
+        log (log::ERR, "Invalid loop size, last index is %zu", index);
+        *flags |= list::BROKEN_DATA_LOOP;
+        return;
+    }   
+}
+
+// ----------------------------------------------------------------------------
+
+static void verify_free_loop  (const list::list_t *list, list::err_flags *flags)
+{
+    assert (list  != nullptr && "pointer can't be nullptr");
+    assert (flags != nullptr && "pointer can't be nullptr");
+
+    size_t index = list->free_head;
+
+    // Verify head
+
+    if (index > list->capacity)
+    {
+        log (log::ERR, "Free head out of bounds");
+        *flags |= list::BROKEN_FREE_LOOP;
+        return;
+    }
+
+    if (index == 0)
+    {
+        if (list->size != list->capacity)
+        {
+            log (log::ERR, "No free cells, but size != capacity");
+            *flags |= list::BROKEN_FREE_LOOP;
+            return;
+        }
+        else
+        {
+            return;
+        }
+    }
+
+    // Iterate
+
+    size_t prev_index = 0;
+
+    for (size_t i = 0; i < list->capacity - list->size; ++i)
+    {
+        if (list->prev_arr[index] != to_index (FREE_FLAG | prev_index))
+        {
+            log (log::ERR, "Invalid free cell %zu", i);
+            *flags |= list::BROKEN_FREE_LOOP;
+            return;
+        }
+
+        prev_index = index;
+        index = list->next_arr[index];
+
+        if (index > list->capacity)
+        {
+            log (log::ERR, "Next index out of bounds");
+            *flags |= list::BROKEN_FREE_LOOP;
+            return;
+        }
+    }
+
+    // Check loop
+
+    if (index != 0 || prev_index != list->free_back)
+    {
+        log (log::ERR, "Broken free loop, index = %zu", index);
+        *flags |= list::BROKEN_FREE_LOOP;
+        return;
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+// Shown cells are copied, so the list may change while the dump waits for a worker
+static dump_capture_t *capture_dump (const list::list_t *list, const list::dump_window_t *window)
+{
+    assert (list   != nullptr && "pointer can't be null");
+    assert (window != nullptr && "pointer can't be null");
+
+    std::vector<size_t> selected;
+    select_cells (list, window, &selected);
+
+    size_t n_cells = selected.size ();
+
+    dump_capture_t *capture = (dump_capture_t *) calloc (1, sizeof (dump_capture_t));
+    if (capture == nullptr)
+    {
+        return nullptr;
+    }
+
+    memcpy ((void *) &capture->header, list, sizeof (list::list_t));
+    capture->header.data_arr    = nullptr;
+    capture->header.next_arr    = nullptr;
+    capture->header.prev_arr    = nullptr;
+    capture->header.order_index = nullptr;
+    capture->header.allocator   = nullptr;
+
+    capture->cells = (dump_cell_t *) calloc (n_cells, sizeof (dump_cell_t));
+    capture->data  = (char *)        calloc (n_cells, list->obj_size);
+    capture->gaps  = (dump_gap_t *)  calloc (n_cells, sizeof (dump_gap_t));
+
+    if (capture->cells == nullptr || capture->data == nullptr || capture->gaps == nullptr)
+    {
+        free_capture (capture);
+        return nullptr;
+    }
+
+    for (size_t i = 0; i < n_cells; ++i)
+    {
+        size_t       index = selected[i];
+        dump_cell_t *cell  = &capture->cells[i];
+
+        cell->index = index;
+        cell->next  = list->next_arr[index];
+        cell->prev  = list->prev_arr[index] & INDEX_MASK;
+        cell->state = cell_state (list, index);
+
+        if (cell->state != DUMP_CELL_FREE && cell->state != DUMP_CELL_NULL)
+        {
+            memcpy (capture->data + i * list->obj_size,
+                    (char *) list->data_arr + index * list->obj_size, list->obj_size);
+        }
+
+        // Skipped cells up to the next shown one (or the end)
+        size_t gap_end = (i + 1 < n_cells) ? selected[i + 1] : list->capacity + 1;
+        if (gap_end > index + 1)
+        {
+            dump_gap_t *gap = &capture->gaps[capture->n_gaps++];
+
+            gap->first = index + 1;
+            gap->last  = gap_end - 1;
+
+            for (size_t j = gap->first; j <= gap->last; ++j)
+            {
+                gap->free += is_free_cell (list, j);
+            }
+            gap->live = gap->last - gap->first + 1 - gap->free;
+        }
+    }
+
+    capture->n_cells = n_cells;
+
+    return capture;
+}
+
+static void free_capture (dump_capture_t *capture)
+{
+    assert (capture != nullptr && "pointer can't be null");
+
+    free (capture->cells);
+    free (capture->data);
+    free (capture->gaps);
+    free (capture);
+}
+
+// Sorted unique cell indexes for window, null cell is always there
+static void select_cells (const list::list_t *list, const list::dump_window_t *window,
+                          std::vector<size_t> *cells)
+{
+    assert (list   != nullptr && "pointer can't be null");
+    assert (window != nullptr && "pointer can't be null");
+    assert (cells  != nullptr && "pointer can't be null");
+
+    cells->push_back (0);
+
+    switch (window->mode)
+    {
+        case list::DUMP_ALL:
+            add_cell_range (list, cells, 0, list->capacity);
+            break;
+
+        case list::DUMP_CELLS:
+            add_cell_range (list, cells, window->center, window->radius);
+            break;
+
+        case list::DUMP_LOGICAL:
+        {
+            if (list->size == 0)
+            {
+                break;
+            }
+
+            size_t first = (window->center > window->radius) ? window->center - window->radius : 0;
+            size_t count = 2 * window->radius + 1;
+
+            // Links are followed with bounds checks, list may be broken
+            size_t index = list->next_arr[0];
+            if (list->is_sorted)
+            {
+                index = (first < list->size) ? index + first : 0;
+            }
+            else if (list->order_index != nullptr && first < list->size)
+            {
+                index = list::order::kth (list->order_index, first);
+            }
+            else
+            {
+                for (size_t i = 0; i < first && index != 0 && index <= list->capacity; ++i)
+                {
+                    index = list->next_arr[index];
+                }
+            }
+
+            for (size_t i = 0; i < count && index != 0 && index <= list->capacity; ++i)
+            {
+                cells->push_back (index);
+                index = list->next_arr[index];
+            }
+
+            break;
+        }
+
+        case list::DUMP_BROKEN:
+        {
+            size_t broken = 0;
+            for (size_t i = 0; i <= list->capacity && broken < DUMP_MAX_BROKEN; ++i)
+            {
+                if (cell_state (list, i) != DUMP_CELL_INVALID)
+                {
+                    continue;
+                }
+
+                add_cell_range (list, cells, i, window->radius);
+                add_cell_range (list, cells, list->next_arr[i], 0);
+                add_cell_range (list, cells, list->prev_arr[i] & INDEX_MASK, 0);
+                broken++;
+            }
+
+            break;
+        }
+
+        default:
+            assert (0 && "Unknown dump mode");
+            break;
+    }
+
+    std::sort (cells->begin (), cells->end ());
+    cells->erase (std::unique (cells->begin (), cells->end ()), cells->end ());
+}
+
+// Physical cells [center - radius, center + radius] clipped to capacity
+static void add_cell_range (const list::list_t *list, std::vector<size_t> *cells,
+                            size_t center, size_t radius)
+{
+    assert (list  != nullptr && "pointer can't be null");
+    assert (cells != nullptr && "pointer can't be null");
+
+    if (center > list->capacity)
+    {
+        return;
+    }
+
+    size_t first = (center > radius) ? center - radius : 0;
+    size_t last  = (list->capacity - center > radius) ? center + radius : list->capacity;
+
+    for (size_t i = first; i <= last; ++i)
+    {
+        cells->push_back (i);
+    }
+}
+
+// Silent: broken lists are dumped from failure paths
+static dump_cell_state_t cell_state (const list::list_t *list, size_t index)
+{
+    assert (list != nullptr && "pointer can't be null");
+
+    if (is_free_cell (list, index))
+    {
+        size_t next = list->next_arr[index];
+
+        return (index != 0 && next <= list->capacity && (next == 0 || is_free_cell (list, next))) ?
+               DUMP_CELL_FREE : DUMP_CELL_INVALID;
+    }
+
+    if (!check_links (list, index))
+    {
+        return DUMP_CELL_INVALID;
+    }
+
+    return (index == 0) ? DUMP_CELL_NULL : DUMP_CELL_LIVE;
+}
+
+// ----------------------------------------------------------------------------
+
+// Called under dumps.mutex. Under load waiting dumps are coalesced: a dump
+// within interval replaces the newest waiting one, a full queue drops the oldest.
+static void enqueue_dump (dump_job_t *job)
+{
+    assert (job != nullptr && "pointer can't be null");
+
+    auto now = std::chrono::steady_clock::now ();
+    auto gap = std::chrono::duration_cast<std::chrono::milliseconds> (now - dumps.last_enqueue);
+
+    if (!dumps.queue.empty () && (size_t) gap.count () < dumps.interval_ms)
+    {
+        dump_job_t *replaced = &dumps.queue.back ();
+
+        job->skipped = replaced->skipped + 1;
+        free_capture (replaced->capture);
+        dumps.stats.dropped++;
+
+        *replaced = *job;
+    }
+    else
+    {
+        if (dumps.queue.size () >= dumps.max_pending)
+        {
+            dump_job_t dropped = dumps.queue.front ();
+            dumps.queue.pop_front ();
+
+            dump_job_t *heir = dumps.queue.empty () ? job : &dumps.queue.front ();
+            heir->skipped += dropped.skipped + 1;
 
-    fprintf (stream, "List dump:\n");
+            free_capture (dropped.capture);
+            dumps.stats.dropped++;
+        }
 
-    fprintf (stream, "\tfree_head: %zu\n", list->free_head);
-    fprintf (stream, "\tobj_size:  %zu\n", list->obj_size);
-    fprintf (stream, "\treserved:  %zu\n", list->reserved);
-    fprintf (stream, "\tcapacity:  %zu\n", list->capacity);
-    fprintf (stream, "\tsize:      %zu\n", list->size);
+        dumps.queue.push_back (*job);
+        dumps.last_enqueue = now;
+    }
+
+    dumps.work_cv.notify_one ();
+}
+
+static void render_dump (dump_job_t *job)
+{
+    assert (job != nullptr && "pointer can't be null");
+
+    char filepath[DUMP_FILE_PATH_LEN+1] = "";
+    snprintf (filepath, sizeof (filepath), DUMP_FILE_PATH_FORMAT, job->number);
 
-    fprintf(stream ,"INDX: ");
-    for (size_t i = 0; i <= list->capacity; ++i)
+    FILE *dump_file = fopen (filepath, "w");
+    if (dump_file == nullptr)
     {
-        fprintf (stream, "%3zu ", i);
+        log (log::ERR, "Failed to open dump file '%s'", filepath);
     }
-
-    fprintf (stream, "\nData: ");
-    for (size_t i = 0; i <= list->capacity; ++i)
+    else
     {
-        if (list->prev_arr[i] != FREE_PREV)
-        {
-            fprintf (stream, "%3d ", ((int *)list->data_arr)[i]);
-        }
-        else
+        // Large buffer: huge dumps go out in few big writes
+        setvbuf (dump_file, nullptr, _IOFBF, DUMP_STREAM_BUFFER);
+
+        generate_graphiz_code (job->capture, dump_file);
+        fclose (dump_file);
+
+        char cmd[2*DUMP_FILE_PATH_LEN+20+1] = "";
+        snprintf (cmd, sizeof (cmd), "dot -T png -o %s.png %s", filepath, filepath);
+        if (system (cmd) != 0)
         {
-            fprintf (stream, "  F ");
+            log (log::ERR, "Failed to execute '%s'", cmd);
         }
+
+        // One fprintf per entry, so entries of parallel workers don't interleave
+        #if HTML_LOGS
+            char note[64] = "";
+            if (job->skipped > 0)
+            {
+                snprintf (note, sizeof (note), "<p>%zu earlier dumps skipped</p>\n", job->skipped);
+            }
+
+            fprintf (get_log_stream (), "\n<hr>\n<h2>List dump: %s</h2>\n%s\n<img src=\"%s.png\">\n\n",
+                     job->reason, note, filepath);
+        #else
+            log (log::INF, "Dump path: %s.png (%s, %zu earlier dumps skipped)",
+                 filepath, job->reason, job->skipped);
+        #endif
+
+        fflush (get_log_stream ());
     }
 
-    fprintf (stream, "\nPrev: ");
-    for (size_t i = 0; i <= list->capacity; ++i)
+    free_capture (job->capture);
+    job->capture = nullptr;
+
+    std::lock_guard<std::mutex> lock (dumps.mutex);
+    dumps.stats.rendered++;
+}
+
+static void dump_worker ()
+{
+    std::unique_lock<std::mutex> lock (dumps.mutex);
+
+    while (true)
     {
-        if (list->prev_arr[i] == FREE_PREV)
+        dumps.work_cv.wait (lock, [] { return dumps.stop || !dumps.queue.empty (); });
+
+        // Queue is drained before stopping
+        if (dumps.queue.empty ())
         {
-            fprintf (stream, "  F ");
+            return;
         }
-        else
+
+        dump_job_t job = dumps.queue.front ();
+        dumps.queue.pop_front ();
+        dumps.in_flight++;
+
+        lock.unlock ();
+        render_dump (&job);
+        lock.lock ();
+
+        dumps.in_flight--;
+        if (dumps.queue.empty () && dumps.in_flight == 0)
         {
-            fprintf (stream, "%3zu ", list->prev_arr[i]);
+            dumps.done_cv.notify_all ();
         }
     }
+}
+
+static void stop_dump_workers ()
+{
+    std::vector<std::thread> threads;
+    {
+        std::lock_guard<std::mutex> lock (dumps.mutex);
+        dumps.stop = true;
+        threads.swap (dumps.threads);
+    }
 
-    fprintf (stream, "\nNext: ");
-    for (size_t i = 0; i <= list->capacity; ++i)
+    dumps.work_cv.notify_all ();
+    for (std::thread &thread : threads)
     {
-        fprintf (stream, "%3zd ", (ssize_t) list->next_arr[i]);
+        thread.join ();
     }
-    fputc ('\n', stream);
+
+    std::lock_guard<std::mutex> lock (dumps.mutex);
+    dumps.stop = false;
 }
 
 // ----------------------------------------------------------------------------
 
-void list::graph_dump (const list::list_t *list, const char *reason_fmt, ...)
+static void generate_graphiz_code (const dump_capture_t *capture, FILE *stream)
 {
-    assert (list != nullptr && "pointer can't be nullptr");
+    assert (capture != nullptr && "pointer can't be null");
+    assert (stream  != nullptr && "pointer can't be null");
 
-    static int counter = 0;
-    counter++;
+    const list::list_t *list = &capture->header;
 
-    char filepath[DUMP_FILE_PATH_LEN+1] = "";    
-    sprintf (filepath, DUMP_FILE_PATH_FORMAT, counter);
+    fprintf (stream, PREFIX);
 
-    FILE *dump_file = fopen (filepath, "w");
-    if (dump_file == nullptr)
+    fprintf (stream, "node_main [label = \" "
+                    "   capacity: %zu | obj_size: %zu | is_sorted: %s (%d)"
+                      "| reserved: %zu | size: %zu | shown: %zu|<fh>free_head: %" LIST_IDX_FMT
+                      " | <fb> free_back: %" LIST_IDX_FMT "\"]\n",
+                      list->capacity, list->obj_size, list->is_sorted ? "true" : "false", list->is_sorted,
+                      list->reserved, list->size, capture->n_cells, list->free_head, list->free_back);
+
+    ref_codegen (capture, list->free_back, stream);
+    ref_codegen (capture, list->free_head, stream);
+    fprintf (stream, "node_main:fb -> node_%" LIST_IDX_FMT " [style=\"dotted\", color = \"skyblue\"]", list->free_back);
+    fprintf (stream, "node_main:fh -> node_%" LIST_IDX_FMT " [style=\"dotted\", color = \"skyblue\"]", list->free_head);
+    fprintf (stream, "node_main    -> node_0   [style=\"invis\", weight=100]");
+
+    fprintf (stream, "node_ind_struct [label=\"STRUCT\", fillcolor=\"white\"]\n");
+    fprintf (stream, "node_ind_struct -> node_ind_0 [style=\"invis\", weight = 100]\n");
+
+    // Shown cells and gap summaries go in index order, chained by invisible edges
+    size_t gap = 0;
+    for (size_t pos = 0; pos < capture->n_cells; ++pos)
     {
-        log (log::ERR, "Failed to open dump file '%s'", filepath);
-        return;
+        size_t index = capture->cells[pos].index;
+
+        fprintf (stream, "node_ind_%zu [label=\"%zu\", fillcolor=\"white\"]", index, index);
+
+        node_codegen (capture, pos, stream);
+        edge_codegen (capture, pos, stream);
+
+        if (gap < capture->n_gaps && capture->gaps[gap].first == index + 1)
+        {
+            gap_codegen (&capture->gaps[gap], stream);
+            gap++;
+        }
     }
 
-    generate_graphiz_code (list, dump_file);
-    fclose (dump_file);
+    fprintf (stream ,"}");
+}
+
+// ----------------------------------------------------------------------------
+
+static void set_colors (dump_cell_state_t state, const char **fillcolor, const char **color)
+{
+    assert (fillcolor != nullptr && "invalid pointer");
+    assert (color     != nullptr && "invalid pointer");
 
-    char cmd[2*DUMP_FILE_PATH_LEN+20+1] = "";
-    sprintf (cmd, "dot -T png -o %s.png %s", filepath, filepath);
-    if (system (cmd) != 0)
+    switch (state)
     {
-        log (log::ERR, "Failed to execute '%s'", cmd);
+        case DUMP_CELL_NULL:
+            *color     = NULLCELL_COLOR;
+            *fillcolor = NULLCELL_FILLCOLOR;
+            break;
+
+        case DUMP_CELL_FREE:
+            *color     = FREE_COLOR;
+            *fillcolor = FREE_FILLCOLOR;
+            break;
+
+        case DUMP_CELL_LIVE:
+            *color     = REGULAR_COLOR;
+            *fillcolor = REGULAR_FILLCOLOR;
+            break;
+
+        case DUMP_CELL_INVALID:
+        default:
+            *color     = INVALID_COLOR;
+            *fillcolor = INVALID_FILLCOLOR;
+            break;
     }
+}
 
-    va_list args;
-    va_start (args, reason_fmt);
+// ----------------------------------------------------------------------------
 
-    #if HTML_LOGS
-        fprintf  (get_log_stream(), "<h2>List dump: ");
-        vfprintf (get_log_stream(), reason_fmt, args);
-        fprintf  (get_log_stream(), "</h2>");
+static void node_codegen (const dump_capture_t *capture, size_t pos, FILE *stream)
+{
+    assert (capture != nullptr && "invalid pointer");
+    assert (stream  != nullptr && "invalid pointer");
 
-        fprintf (get_log_stream(), "\n\n<img src=\"%s.png\">\n\n", filepath);
-    #else
-        log (log::INF, "Dump path: %s.png", filepath);
-    #endif
+    const dump_cell_t *cell = &capture->cells[pos];
 
-    va_end (args);
+    const char *fillcolor = nullptr;
+    const char *color     = nullptr;
+    set_colors (cell->state, &fillcolor, &color);
+
+    if (cell->state == DUMP_CELL_FREE)
+    {
+        fprintf (stream, "node_%zu [label = \"FREE | FREE", cell->index);
+    }
+    else
+    {
+        fprintf (stream, "node_%zu [label = \"", cell->index);
+        if (cell->index != 0)
+        {
+            capture->header.print_func (capture->data + pos * capture->header.obj_size, stream);
+        }
+        else
+        {
+            fprintf (stream, "nil");
+        }
+        fprintf (stream, "| p: %zu", cell->prev);
+    }
 
-    fflush (get_log_stream ());
+    fprintf (stream, "| <next> n: %zu", cell->next);
+    fprintf (stream, "\"fillcolor=\"%s\", color=\"%s\"];\n",
+                         fillcolor, color);
 }
 
 // ----------------------------------------------------------------------------
 
-const char *list::err_to_str (const list::err_t err)
+static void edge_codegen (const dump_capture_t *capture, size_t pos, FILE *stream)
 {
-    switch (err)
-    {
-        case list::OK:
-            return "OK";
+    assert (capture != nullptr && "pointer can't be nullptr");
+    assert (stream  != nullptr && "pointer can't be nullptr");
 
-        case list::OOM:
-            return "Out Of Memory";
+    const dump_cell_t *cell    = &capture->cells[pos];
+    bool               is_free = cell->state == DUMP_CELL_FREE;
 
-        case list::EMPTY:
-            return "List is empty";
+    // Invisible edge to the next shown cell, or to the gap summary before it
+    if (cell->index < capture->header.capacity)
+    {
+        if (pos + 1 < capture->n_cells && capture->cells[pos + 1].index == cell->index + 1)
+        {
+            fprintf (stream, "node_%zu->node_%zu [style=invis, weight = 60]\n",
+                        cell->index, cell->index + 1);
+            fprintf (stream, "node_ind_%zu->node_ind_%zu [style=invis, weight = 100]\n",
+                        cell->index, cell->index + 1);
+        }
+        else
+        {
+            fprintf (stream, "node_%zu->gap_%zu [style=invis, weight = 60]\n",
+                        cell->index, cell->index + 1);
+            fprintf (stream, "node_ind_%zu->node_ind_gap_%zu [style=invis, weight = 100]\n",
+                        cell->index, cell->index + 1);
+        }
+    }
 
-        case list::NULLPTR:
-            return "List pointer is nullptr";
+    // Prev edge
+    if (!is_free)
+    {
+        ref_codegen (capture, cell->prev, stream);
+        fprintf (stream, "node_%zu -> node_%zu [color = \"%s\","
+                         "constraint=false];\n", cell->index, cell->prev,
+                         PREV_EDGE_COLOR);
+    }
 
-        case list::INVALID_CAPACITY:
-            return "Invalid capacity";
+    // Next edge
+    ref_codegen (capture, cell->next, stream);
+    fprintf (stream, "node_%zu -> node_%zu [color = \"%s\",%s"
+                     "constraint=false];\n", cell->index, cell->next,
+                     NEXT_EDGE_COLOR, is_free ? " style=\"dashed\"," : "");
+}
 
-        case list::INVALID_SIZE:
-            return "Invalid size";
+// Gap summary node, chained to the next shown cell
+static void gap_codegen (const dump_gap_t *gap, FILE *stream)
+{
+    assert (gap    != nullptr && "pointer can't be nullptr");
+    assert (stream != nullptr && "pointer can't be nullptr");
 
-        case list::BROKEN_DATA_LOOP:
-            return "Broken data loop";
+    fprintf (stream, "gap_%zu [label = \"cells %zu..%zu | live: %zu | free: %zu\", "
+                     "fillcolor=\"white\", style=\"dashed\"];\n",
+                     gap->first, gap->first, gap->last, gap->live, gap->free);
+    fprintf (stream, "node_ind_gap_%zu [label=\"...\", fillcolor=\"white\"]\n", gap->first);
 
-        case list::BROKEN_FREE_LOOP:
-            return "Broken free loop";
+    fprintf (stream, "gap_%zu->node_%zu [style=invis, weight = 60]\n", gap->first, gap->last + 1);
+    fprintf (stream, "node_ind_gap_%zu->node_ind_%zu [style=invis, weight = 100]\n",
+                     gap->first, gap->last + 1);
+}
 
-        default:
-            assert (0 && "Unexpected error code");
+// Links into skipped cells end at small label nodes
+static void ref_codegen (const dump_capture_t *capture, size_t index, FILE *stream)
+{
+    assert (capture != nullptr && "pointer can't be nullptr");
+    assert (stream  != nullptr && "pointer can't be nullptr");
+
+    if (!is_captured (capture, index))
+    {
+        fprintf (stream, "node_%zu [label=\"%zu\", shape=plaintext, style=\"\"]\n", index, index);
     }
 }
 
-// ----------------------------------------------------------------------------
-// STATIC FUNCTIONS
+static bool is_captured (const dump_capture_t *capture, size_t index)
+{
+    assert (capture != nullptr && "pointer can't be nullptr");
+
+    const dump_cell_t *end  = capture->cells + capture->n_cells;
+    const dump_cell_t *cell = std::lower_bound ((const dump_cell_t *) capture->cells, end, index,
+                                  [] (const dump_cell_t &c, size_t i) { return c.index < i; });
+
+    return cell != end && cell->index == index;
+}
+
 // ----------------------------------------------------------------------------
 
-static ssize_t get_free_cell (list::list_t *list)
+static list::err_t write_blocks (FILE *stream, const void *arr, size_t elem_size, size_t count)
 {
-    assert (list != nullptr && "pointer can't be nullptr");
+    assert (stream != nullptr && "pointer can't be nullptr");
+    assert (arr    != nullptr && "pointer can't be nullptr");
 
-    list::err_t res = list::OK;
+    size_t block_elems = SNAPSHOT_BLOCK / elem_size + 1;
 
-    // If we need reallocation
-    if (list->free_head == 0) 
+    for (size_t done = 0; done < count; )
     {
-        if (list->capacity == 0)
-        {
-            res = list::resize (list, 1);
-        }
-        else
+        size_t n = (count - done < block_elems) ? count - done : block_elems;
+
+        list::err_t res = write_block (stream, (const char *) arr + done * elem_size, elem_size, n);
+        if (res != list::OK)
         {
-            res = list::resize (list, list->capacity * 2);
+            return res;
         }
 
+        done += n;
+    }
+
+    return list::OK;
+}
+
+static list::err_t read_blocks (FILE *stream, void *arr, size_t elem_size, size_t count)
+{
+    assert (stream != nullptr && "pointer can't be nullptr");
+    assert (arr    != nullptr && "pointer can't be nullptr");
+
+    size_t block_elems = SNAPSHOT_BLOCK / elem_size + 1;
+
+    for (size_t done = 0; done < count; )
+    {
+        size_t n = (count - done < block_elems) ? count - done : block_elems;
 
+        list::err_t res = read_block (stream, (char *) arr + done * elem_size, elem_size, n);
         if (res != list::OK)
         {
-            log (log::ERR, "Failed to reallocate with error '%s'", list::err_to_str (res));
-            return ERROR;
+            return res;
         }
+
+        done += n;
     }
 
-    size_t free_index = list->free_head;
+    return list::OK;
+}
+
+static list::err_t write_block (FILE *stream, const void *block, size_t elem_size, size_t count)
+{
+    assert (stream != nullptr && "pointer can't be nullptr");
+    assert (block  != nullptr && "pointer can't be nullptr");
 
-    list->free_head = list->next_arr[list->free_head];
+    uint64_t count_le = count;
+    uint64_t sum      = checksum (block, elem_size * count);
 
-    if (list->free_head == 0)
+    if (fwrite (&count_le, sizeof (count_le), 1, stream) != 1 ||
+        fwrite (block, elem_size, count, stream) != count    ||
+        fwrite (&sum, sizeof (sum), 1, stream) != 1)
     {
-        list->free_back = 0;
+        log (log::ERR, "Failed to write snapshot block");
+        return list::IO_ERROR;
     }
 
-    list->size++;
+    return list::OK;
+}
 
-    return (ssize_t) free_index;
+static list::err_t read_block (FILE *stream, void *block, size_t elem_size, size_t count)
+{
+    assert (stream != nullptr && "pointer can't be nullptr");
+    assert (block  != nullptr && "pointer can't be nullptr");
+
+    uint64_t block_count = 0;
+    uint64_t sum         = 0;
+
+    if (fread (&block_count, sizeof (block_count), 1, stream) != 1)
+    {
+        log (log::ERR, "Snapshot is truncated");
+        return list::IO_ERROR;
+    }
+
+    if (block_count != count)
+    {
+        log (log::ERR, "Snapshot block has %" PRIu64 " elements, expected %zu", block_count, count);
+        return list::BAD_FORMAT;
+    }
+
+    if (fread (block, elem_size, count, stream) != count ||
+        fread (&sum, sizeof (sum), 1, stream) != 1)
+    {
+        log (log::ERR, "Snapshot is truncated");
+        return list::IO_ERROR;
+    }
+
+    if (sum != checksum (block, elem_size * count))
+    {
+        log (log::ERR, "Snapshot block checksum mismatch");
+        return list::BAD_FORMAT;
+    }
+
+    return list::OK;
 }
 
-static void release_free_cell (list::list_t *list, size_t index)
+// FNV-1a over 64-bit words, tail bytes are folded in one by one
+static uint64_t checksum (const void *data, size_t size)
 {
-    assert (list != nullptr && "pointer can't be nullptr");
-    assert (check_index (list, index, false) && "invalid index");
+    assert (data != nullptr && "pointer can't be nullptr");
 
-    list->next_arr[index] = list->free_head;
-    list->prev_arr[index] = FREE_PREV;
-    list->free_head       = index;
-    list->size--;
+    const uint64_t PRIME = 0x100000001B3;
+    const char    *bytes = (const char *) data;
+    uint64_t       hash  = 0xCBF29CE484222325;
+
+    size_t i = 0;
+    for (; i + sizeof (uint64_t) <= size; i += sizeof (uint64_t))
+    {
+        uint64_t word = 0;
+        memcpy (&word, bytes + i, sizeof (word));
+        hash = (hash ^ word) * PRIME;
+    }
+
+    for (; i < size; ++i)
+    {
+        hash = (hash ^ (uint8_t) bytes[i]) * PRIME;
+    }
+
+    return hash;
+}
+
+// ----------------------------------------------------------------------------
+
+// Storage goes through list allocator, libc is used when there is none
+static void *mem_alloc (const list::list_t *list, size_t size)
+{
+    assert (list != nullptr && "pointer can't be null");
+
+    return list::allocate (list->allocator, size);
+}
+
+static void mem_free (const list::list_t *list, void *ptr, size_t size)
+{
+    assert (list != nullptr && "pointer can't be null");
+
+    list::deallocate (list->allocator, ptr, size);
+}
+
+// ----------------------------------------------------------------------------
+
+static list::err_t recalloc_no_sorting  (list::list_t *list, size_t new_capacity)
+{
+    assert (list != nullptr && "pointer can't be null");
+
+    void  *arrays    [] = {list->data_arr, list->next_arr, list->prev_arr};
+    size_t elem_sizes[] = {list->obj_size, sizeof (list::index_t), sizeof (list::index_t)};
+
+    size_t old_cells = list->capacity + 1;
+    bool   resized   = list::reallocate_arrays (list->allocator, arrays, elem_sizes,
+                                                sizeof (arrays) / sizeof (arrays[0]),
+                                                old_cells, new_capacity + 1);
+
+    list->data_arr = arrays[0];
+    list->next_arr = (list::index_t *) arrays[1];
+    list->prev_arr = (list::index_t *) arrays[2];
+
+    if (!resized)
+    {
+        return list::OOM;
+    }
+
+    _STAT (list, resizes, 1);
+    _STAT (list, resize_bytes, old_cells * (list->obj_size + 2 * sizeof (list::index_t)));
+
+    return list::OK;
 }
 
-// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+
+static list::err_t recalloc_and_sorting (list::list_t *list, size_t new_capacity)
+{
+    assert (list != nullptr && "pointer can't be null");
+
+    char *new_data = (char *) mem_alloc (list, (new_capacity + 1) * list->obj_size);
+    if (new_data == nullptr) { return list::OOM; }
+
+#if LIST_STATS
+    size_t start_ns = now_ns ();
+#endif
+
+    char *new_elem_ptr = new_data;
+    char *old_elem_ptr = nullptr;
+    size_t index       = 0;
+
+    // Copy to new buffer
+    for (size_t i = 0; i < list->size; ++i)
+    {
+        index = list->next_arr[index];
+        old_elem_ptr  = (char*)list->data_arr + index * list->obj_size;
+        new_elem_ptr += list->obj_size;
+
+        memcpy (new_elem_ptr, old_elem_ptr, list->obj_size);
+    }
 
-#define _ERR_CASE(cond, msg)                        \
-{                                                   \
-    if (cond)                                       \
-    {                                               \
-        log (log::DBG, "Invalid index (%s)", msg);  \
-        return false;                               \
-    }                                               \
-}
+    mem_free (list, list->data_arr, (list->capacity + 1) * list->obj_size);
+    list->data_arr = new_data;
 
-static bool check_index (const list::list_t *list, size_t index, bool can_be_zero)
-{
-    assert (list != nullptr && "pointer can't be nullptr");
+    relink_linear (list);
 
-    _ERR_CASE (!can_be_zero && index == 0, "null");
-    _ERR_CASE (index > list->capacity, "out of bounds");
-    _ERR_CASE (list->prev_arr[index] == FREE_PREV, "points to free cell");
+    _STAT (list, linearises, 1);
+    _STAT (list, linearise_ns, now_ns () - start_ns);
 
-    return true;
+    return list::OK;
 }
 
-#undef _ERR_CASE
-
 // ----------------------------------------------------------------------------
 
-static bool check_cell (const list::list_t *list, size_t index)
+// Sparse ruling set list ranking. Rulers are tagged with FREE_FLAG | id in
+// prev_arr (a live cell never has the tag, and relinking rewrites it), then:
+//  1. each sublist is walked from its ruler to the next tagged cell (parallel)
+//  2. ruler ranks are prefix sums along the chain of rulers (serial, O(rulers))
+//  3. each sublist is walked again, payloads go to their ranks (parallel)
+//  4. links are rewritten by ranges of cells (parallel)
+static list::err_t linearise_parallel (list::list_t *list, size_t threads)
 {
     assert (list != nullptr && "pointer can't be null");
 
-    if (!check_index (list, index, false))
-    {
-        log (log::DBG, "current index is incorrect");
-        return false;
-    }
+#if LIST_STATS
+    size_t start_ns = now_ns ();
+#endif
 
-    if (list->prev_arr[index] == FREE_PREV)
-    {
-        log (log::ERR, "Free cell");
-        return false;
-    }
+    size_t max_rulers = std::min (list->size, threads * RULERS_PER_THREAD);
 
-    if (!check_index (list, list->next_arr[index], true))
+    ruler_t *rulers = (ruler_t *) mem_alloc (list, max_rulers * sizeof (ruler_t));
+    UNWRAP_MALLOC (rulers);
+
+    char *new_data = (char *) mem_alloc (list, (list->capacity + 1) * list->obj_size);
+    if (new_data == nullptr)
     {
-        log (log::ERR, "next index is incorrect");
-        return false;
+        mem_free (list, rulers, max_rulers * sizeof (ruler_t));
+        log (log::ERR, "OOM");
+        return list::OOM;
     }
 
-    if (!check_index (list, list->prev_arr[index], true))
+    size_t n_rulers = pick_rulers (list, rulers, max_rulers);
+
+    run_parallel (threads, n_rulers, [list, rulers] (size_t id)
     {
-        log (log::ERR, "prev index is incorrect");
-        return false;
-    }
+        size_t length = 1;
+        size_t cell   = list->next_arr[rulers[id].cell];
 
-    if (list->next_arr[list->prev_arr[index]] != index)
+        while (cell != 0 && (list->prev_arr[cell] & FREE_FLAG) == 0)
+        {
+            length++;
+            cell = list->next_arr[cell];
+        }
+
+        rulers[id].length = length;
+        rulers[id].next   = (cell == 0) ? SIZE_MAX : (list->prev_arr[cell] & INDEX_MASK);
+    });
+
+    // Ruler 0 is the head
+    size_t rank = 1;
+    for (size_t id = 0; id != SIZE_MAX; id = rulers[id].next)
     {
-        log (log::ERR, "next[prev[index]] != index");
-        return false;
+        rulers[id].base = rank;
+        rank += rulers[id].length;
     }
+    assert (rank == list->size + 1 && "rulers don't cover the list");
 
-    if (list->prev_arr[list->next_arr[index]] != index)
+    const char *old_data = (const char *) list->data_arr;
+    size_t      obj_size = list->obj_size;
+
+    run_parallel (threads, n_rulers, [list, rulers, old_data, new_data, obj_size] (size_t id)
     {
-        log (log::ERR, "prev[next[index]] != index");
-        return false;
-    }
+        size_t cell = rulers[id].cell;
+        char  *dst  = new_data + rulers[id].base * obj_size;
 
-    return true;
-}
+        for (size_t i = 0; i < rulers[id].length; ++i)
+        {
+            memcpy (dst, old_data + cell * obj_size, obj_size);
+            dst += obj_size;
+            cell = list->next_arr[cell];
+        }
+    });
 
-// ----------------------------------------------------------------------------
+    mem_free (list, rulers, max_rulers * sizeof (ruler_t));
 
-static void verify_data_loop  (const list::list_t *list, list::err_flags *flags)
-{
-    assert (list  != nullptr && "pointer can't be nullptr");
-    assert (flags != nullptr && "pointer can't be nullptr");
+    mem_free (list, list->data_arr, (list->capacity + 1) * list->obj_size);
+    list->data_arr = new_data;
 
-    size_t index = list->next_arr[0];
+    size_t cells = list->capacity + 1;
+    size_t step  = (cells + threads - 1) / threads;
 
-    if (!check_index (list, index, true))
+    run_parallel (threads, threads, [list, cells, step] (size_t part)
     {
-        *flags |= list::BROKEN_DATA_LOOP;
-        return;
-    }
+        size_t from = std::max (part * step, (size_t) 1);
+        size_t to   = std::min ((part + 1) * step, cells);
 
-    if (*flags == list::OK && list->size > 0)
-    {
-        for (size_t i = 0; i < list->size - 1; ++i)
+        if (from < to)
         {
-            if (check_cell (list, index))
-            {
-                index = list->next_arr[index];
-            }
-            else
-            {
-                log (log::ERR, "Broken cell");
-                *flags |= list::BROKEN_DATA_LOOP;
-                return;
-            }
+            relink_cells (list, from, to);
         }
-    }
+    });
 
-    if (list->next_arr[index] != 0)
-    {
-        log (log::ERR, "Invalid loop size, last index is %zu", index);
-        *flags |= list::BROKEN_DATA_LOOP;
-        return;
-    }   
-}
+    relink_ends (list);
 
-// ----------------------------------------------------------------------------
+    _STAT (list, linearises, 1);
+    _STAT (list, linearise_ns, now_ns () - start_ns);
 
-static void verify_free_loop  (const list::list_t *list, list::err_flags *flags)
+    return list::OK;
+}
+
+// Head plus live cells near evenly spaced storage positions, which are
+// scattered in logical order when the list is fragmented
+static size_t pick_rulers (list::list_t *list, ruler_t *rulers, size_t max_rulers)
 {
-    assert (list  != nullptr && "pointer can't be nullptr");
-    assert (flags != nullptr && "pointer can't be nullptr");
+    assert (list   != nullptr && "pointer can't be null");
+    assert (rulers != nullptr && "pointer can't be null");
 
-    size_t index = list->free_head;
+    size_t n_rulers = 0;
+    size_t head     = list->next_arr[0];
 
-    // Verify head
+    rulers[n_rulers] = {head, 0, SIZE_MAX, 0};
+    list->prev_arr[head] = to_index (FREE_FLAG | n_rulers++);
 
-    if (index > list->capacity)
-    {
-        log (log::ERR, "Free head out of bounds");
-        *flags |= list::BROKEN_FREE_LOOP;
-        return;
-    }
+    size_t spacing = list->capacity / max_rulers + 1;
+    size_t cell    = 1;
 
-    if (index == 0)
+    for (size_t pos = 1; pos <= list->capacity && n_rulers < max_rulers; pos += spacing)
     {
-        if (list->size != list->capacity)
+        cell = std::max (cell, pos);
+        while (cell <= list->capacity && is_free_cell (list, cell))
         {
-            log (log::ERR, "No free cells, but size != capacity");
-            *flags |= list::BROKEN_FREE_LOOP;
-            return;
+            cell++;
         }
-        else
+
+        if (cell > list->capacity)
         {
-            return;
+            break;
         }
-    }
-
-    // Iterate
 
-    for (size_t i = 0; i < list->capacity - list->size; ++i)
-    {
-        if (list->prev_arr[index] != FREE_PREV)
+        if (cell != head)
         {
-            log (log::ERR, "Invalid free cell %zu", i);
-            return;
+            rulers[n_rulers] = {cell, 0, SIZE_MAX, 0};
+            list->prev_arr[cell] = to_index (FREE_FLAG | n_rulers++);
         }
+        cell++;
+    }
 
-        index = list->next_arr[index];
+    return n_rulers;
+}
 
-        if (index > list->capacity)
+// Spreads tasks 0..tasks-1 over threads, the caller is one of them
+template <typename Task>
+static void run_parallel (size_t threads, size_t tasks, Task task)
+{
+    std::atomic<size_t> next_task {0};
+
+    auto worker = [&next_task, tasks, &task] ()
+    {
+        for (size_t id = next_task++; id < tasks; id = next_task++)
         {
-            log (log::ERR, "Next index out of bounds");
-            *flags |= list::BROKEN_FREE_LOOP;
-            return;
+            task (id);
         }
+    };
+
+    std::vector<std::thread> pool;
+    for (size_t i = 1; i < threads; ++i)
+    {
+        pool.emplace_back (worker);
     }
 
-    // Check loop
+    worker ();
 
-    if (index != 0)
+    for (std::thread &thread : pool)
     {
-        log (log::ERR, "Broken free loop, index = %zu", index);
-        *flags |= list::BROKEN_FREE_LOOP;
-        return;
+        thread.join ();
     }
 }
 
 // ----------------------------------------------------------------------------
 
-static void generate_graphiz_code (const list::list_t *list, FILE *stream)
+// Permutation-cycle linearisation: destination ranks are kept in prev_arr,
+// payloads are swapped through the null cell, so no second buffer is needed
+static void linearise_in_place (list::list_t *list)
 {
-    assert (list   != nullptr && "pointer can't be null");
-    assert (stream != nullptr && "pointer can't be null");
-
-    fprintf (stream, PREFIX);
-    const char *fillcolor = nullptr;
-    const char *color     = nullptr;
-
-    fprintf (get_log_stream(), "\n<hr>\n");
+    assert (list != nullptr && "pointer can't be null");
 
-    fprintf (stream, "node_main [label = \" "
-                    "   capacity: %zu | obj_size: %zu | is_sorted: %s (%d)"
-                      "| reserved: %zu | size: %zu|<fh>free_head: %zu | <fb> free_back: %zu\"]\n",
-                      list->capacity, list->obj_size, list->is_sorted ? "true" : "false", list->is_sorted,
-                      list->reserved, list->size, list->free_head, list->free_back);
+    if (list->is_sorted && (list->size == 0 || list->next_arr[0] == 1))
+    {
+        return;
+    }
 
-    fprintf (stream, "node_main:fb -> node_%zu [style=\"dotted\", color = \"skyblue\"]", list->free_back);
-    fprintf (stream, "node_main:fh -> node_%zu [style=\"dotted\", color = \"skyblue\"]", list->free_head);
-    fprintf (stream, "node_main    -> node_0   [style=\"invis\", weight=100]");
+#if LIST_STATS
+    size_t start_ns = now_ns ();
+#endif
 
-    fprintf (stream, "node_ind_struct [label=\"STRUCT\", fillcolor=\"white\"]\n");
-    fprintf (stream, "node_ind_struct -> node_ind_0 [style=\"invis\", weight = 100]\n");
+    size_t index = list->next_arr[0];
+    for (size_t rank = 1; rank <= list->size; ++rank)
+    {
+        list->prev_arr[index] = to_index (rank);
+        index = list->next_arr[index];
+    }
 
+    char  *data    = (char *) list->data_arr;
+    char  *scratch = data;
+    size_t obj     = list->obj_size;
 
-    for (size_t i = 0; i < list->capacity +1; ++i)
+    for (size_t i = 1; i <= list->capacity; ++i)
     {
-        // Set colors
-        set_colors (list, i, &fillcolor, &color);
-
-        fprintf (stream, "node_ind_%zu [label=\"%zu\", fillcolor=\"white\"]", i, i);
+        // Each swap puts one element to its final cell
+        while (!is_free_cell (list, i) && list->prev_arr[i] != i)
+        {
+            size_t dest = list->prev_arr[i];
 
-        // Print node
-        node_codegen (list, i, fillcolor, color, stream);
+            memcpy (scratch,          data + dest * obj, obj);
+            memcpy (data + dest * obj, data + i    * obj, obj);
+            memcpy (data + i    * obj, scratch,          obj);
 
-        // Generate edges
-        edge_codegen (list, i, stream);
+            list->prev_arr[i]    = list->prev_arr[dest];
+            list->prev_arr[dest] = to_index (dest);
+        }
     }
 
-    fprintf (stream ,"}");
+    relink_linear (list);
+
+    _STAT (list, linearises, 1);
+    _STAT (list, linearise_ns, now_ns () - start_ns);
 }
 
 // ----------------------------------------------------------------------------
 
-static void set_colors (const list::list_t *list, size_t index,
-                        const char **fillcolor, const char **color)
+// Cells [from, to) get links of linear layout: live ones up to size, free after
+static void relink_cells (list::list_t *list, size_t from, size_t to)
 {
-    assert (list      != nullptr && "invalid pointer");
-    assert (fillcolor != nullptr && "invalid pointer");
-    assert (color     != nullptr && "invalid pointer");
+    assert (list != nullptr && "pointer can't be null");
 
-    if (index == 0)
+    size_t live_end = std::min (to, list->size + 1);
+
+    for (size_t i = from; i < live_end; ++i)
     {
-        *color     = NULLCELL_COLOR;
-        *fillcolor = NULLCELL_FILLCOLOR;
+        list->next_arr[i] = to_index (i + 1);
+        list->prev_arr[i] = to_index (i - 1);
     }
-    else if (list->prev_arr[index] == FREE_PREV)
+
+    for (size_t i = std::max (from, list->size + 1); i < to; ++i)
     {
-        *color     = FREE_COLOR;
-        *fillcolor = FREE_FILLCOLOR;
+        list->prev_arr[i] = to_index (FREE_FLAG | (i - 1));
+        list->next_arr[i] = to_index (i + 1);
     }
-    else if (check_cell (list, index) || index == 0)
+}
+
+static void relink_ends (list::list_t *list)
+{
+    assert (list != nullptr && "pointer can't be null");
+
+    // Loop
+    list->prev_arr[0] = to_index (list->size);
+    list->next_arr[0] = 1;
+    list->next_arr[list->size] = 0;
+
+    // Free loop ends
+    if (list->size < list->capacity)
     {
-        *color     = REGULAR_COLOR;
-        *fillcolor = REGULAR_FILLCOLOR;
+        list->free_head = to_index (list->size + 1);
+        list->free_back = to_index (list->capacity);
+
+        list->prev_arr[list->size + 1] = FREE_FLAG;
+        list->next_arr[list->capacity] = 0;
     }
     else
     {
-        *color     = INVALID_COLOR;
-        *fillcolor = INVALID_FILLCOLOR;
+        list->free_head = 0;
+        list->free_back = 0;
+    }
+
+    list->is_sorted   = true;
+    list->compact_pos = list->size + 1;
+
+    if (list->order_index != nullptr)
+    {
+        list::order::build (list->order_index, list);
     }
 }
 
 // ----------------------------------------------------------------------------
 
-static void node_codegen (const list::list_t *list, size_t index, const char *fillcolor,
-                        const char *color, FILE *stream)
+// Merges two null-terminated chains of next links, null cell is the dummy head.
+// Ties go to first, so first must come earlier in the list.
+static size_t merge_runs (list::list_t *list, size_t first, size_t second,
+                          int (*cmp)(const void *a, const void *b))
 {
-    assert (list      != nullptr && "invalid pointer");
-    assert (fillcolor != nullptr && "invalid pointer");
-    assert (color     != nullptr && "invalid pointer");
-    assert (stream    != nullptr && "invalid pointer");
+    assert (list != nullptr && "pointer can't be null");
 
-    bool is_free = list->prev_arr[index] == FREE_PREV;
+    const char *data = (const char *) list->data_arr;
+    size_t      obj  = list->obj_size;
+    size_t      tail = 0;
 
-    if (is_free)
-    {
-        fprintf (stream, "node_%zu [label = \"FREE | FREE", index);
-    }
-    else
+    while (first != 0 && second != 0)
     {
-        fprintf (stream, "node_%zu [label = \"", index);
-        if (index != 0)
+        if (cmp (data + second * obj, data + first * obj) < 0)
         {
-            list->print_func ((char *)list->data_arr + index*list->obj_size, stream);
+            list->next_arr[tail] = to_index (second);
+            tail   = second;
+            second = list->next_arr[second];
         }
         else
         {
-            fprintf (stream, "nil"); 
+            list->next_arr[tail] = to_index (first);
+            tail  = first;
+            first = list->next_arr[first];
         }
-        fprintf (stream, "| p: %zu", list->prev_arr[index]);
     }
-    
-    fprintf (stream, "| <next> n: %zu", list->next_arr[index]);
-    fprintf (stream, "\"fillcolor=\"%s\", color=\"%s\"];\n",
-                         fillcolor, color);
-}
-
-// ----------------------------------------------------------------------------
-
-static void edge_codegen (const list::list_t *list, size_t index, FILE *stream)
-{
-    assert (list   != nullptr && "pointer can't be nullptr");
-    assert (stream != nullptr && "pointer can't be nullptr");
-
-    bool is_free = list->prev_arr[index] == FREE_PREV;
 
+    list->next_arr[tail] = to_index ((first != 0) ? first : second);
 
-    // Invisible edge
-    if (index < list->capacity)
-    {
-        fprintf (stream, "node_%zu->node_%zu [style=invis, weight = 60]\n",
-                    index, index+1);
-        fprintf (stream, "node_ind_%zu->node_ind_%zu [style=invis, weight = 100]\n",
-                    index, index+1);
-    }
+    return list->next_arr[0];
+}
 
-    // Prev edge
-    if (!is_free)
+static void radix_pass (const sort_key_t *src, sort_key_t *dst, size_t count,
+                        const size_t *counts, size_t shift)
+{
+    size_t offsets[256] = {};
+    for (size_t digit = 1; digit < 256; ++digit)
     {
-        fprintf (stream, "node_%zu -> node_%zu[color = \"%s\","
-                         "constraint=false];\n", index, list->prev_arr[index],
-                         PREV_EDGE_COLOR);
+        offsets[digit] = offsets[digit - 1] + counts[digit - 1];
     }
 
-    // Next edge
-    if (is_free)
+    for (size_t i = 0; i < count; ++i)
     {
-        fprintf (stream, "node_%zu -> node_%zu[color = \"%s\", style=\"dashed\","
-                         "constraint=false];\n", index, list->next_arr[index],
-                         NEXT_EDGE_COLOR);
+        dst[offsets[(src[i].key >> shift) & 0xFF]++] = src[i];
     }
-    else
-    {
-        fprintf (stream, "node_%zu -> node_%zu[color = \"%s\","
-                         "constraint=false];\n", index, list->next_arr[index],
-                         NEXT_EDGE_COLOR);
-    }   
-}
-
-// ----------------------------------------------------------------------------
-
-#define _REALLOC(ptr, size, type)                              \
-{                                                              \
-    tmp_ptr = realloc (ptr, (new_capacity + 1) * size);        \
-    UNWRAP_MALLOC (tmp_ptr);                                   \
-    _Pragma ("GCC diagnostic push")                            \
-    _Pragma ("GCC diagnostic ignored \"-Wuseless-cast\"")      \
-    ptr = (type) tmp_ptr;                                      \
-    _Pragma ("GCC diagnostic pop")                             \
 }
 
-static list::err_t recalloc_no_sorting  (list::list_t *list, size_t new_capacity)
+// Restores prev links of live cells from next links
+static void relink_prev (list::list_t *list)
 {
     assert (list != nullptr && "pointer can't be null");
 
-    // Realocate arrays
-    void *tmp_ptr = nullptr;
-
-    _REALLOC (list->data_arr,  list->obj_size, void   *);
-    _REALLOC (list->next_arr, sizeof (size_t), size_t *);
-    _REALLOC (list->prev_arr, sizeof (size_t), size_t *);
-
-    return list::OK;
+    size_t prev = 0;
+    for (size_t cell = list->next_arr[0]; cell != 0; cell = list->next_arr[cell])
+    {
+        list->prev_arr[cell] = to_index (prev);
+        prev = cell;
+    }
+    list->prev_arr[0] = to_index (prev);
 }
 
-#undef _REALLOC
-
-// ----------------------------------------------------------------------------
-
-static list::err_t recalloc_and_sorting (list::list_t *list, size_t new_capacity)
+// Logical order changed, storage order is no longer known to match it
+static void finish_value_sort (list::list_t *list, bool linearise)
 {
     assert (list != nullptr && "pointer can't be null");
 
-    char *new_data = (char *) calloc (new_capacity + 1, list->obj_size);
-    if (new_data == nullptr) { return list::OOM; }
-
-    char *new_elem_ptr = new_data;
-    char *old_elem_ptr = nullptr;
-    size_t index       = 0;
+    list->is_sorted   = false;
+    list->compact_pos = 1;
 
-    // Copy to new buffer
-    for (size_t i = 0; i < list->size; ++i)
+    if (linearise)
     {
-        index = list->next_arr[index];
-        old_elem_ptr  = (char*)list->data_arr + index * list->obj_size;
-        new_elem_ptr += list->obj_size;
-
-        memcpy (new_elem_ptr, old_elem_ptr, list->obj_size);
+        linearise_in_place (list);
     }
-
-    // Recreate indexes
-    for (size_t i = 0; i < list->size; ++i)
+    else if (list->order_index != nullptr)
     {
-        list->next_arr[i + 1] = i + 2;
-        list->prev_arr[i + 1] = i;
+        list::order::build (list->order_index, list);
     }
 
-    // Loop
-    list->prev_arr[0] = list->size;
-    list->next_arr[0] = 1;
-    list->next_arr[list->size] = 0;
-
-    // Recreate free loop
-    if (list->free_head != 0)
-    {
-        list->free_head = list->size + 1;
-        list->free_back = list->capacity;
+    list_assert (list);
+}
 
-        for (size_t i = list->size + 1; i < list->capacity + 1; ++i)
-        {
-            list->prev_arr[i] = FREE_PREV;
-            list->next_arr[i] = i + 1;
-        }
+// ----------------------------------------------------------------------------
 
-        list->next_arr[list->capacity] = 0;
-    }
+#if LIST_STATS
+static size_t now_ns ()
+{
+    struct timespec ts = {};
+    clock_gettime (CLOCK_MONOTONIC, &ts);
 
-    free (list->data_arr);
-    list->data_arr  = new_data;
-    list->is_sorted = true;
-    return list::OK;
+    return (size_t) ts.tv_sec * 1000000000 + (size_t) ts.tv_nsec;
 }
+#endif
 
 // ----------------------------------------------------------------------------
 
+#ifdef CRINGE_MODE
 static bool cringe_get_iter_wrapper (size_t index)
 {
     system ("sudo insmod ./kpanic/kpanic.ko");
@@ -1140,4 +3694,5 @@ static bool cringe_get_iter_wrapper (size_t index)
     printf ("Позовите кого-нибудь поумнее, пусть он и работает с этой программой\n");
 
     return false;
-}
\ No newline at end of file
+}
+#endif //CRINGE_MODE
\ No newline at end of file
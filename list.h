@@ -1,22 +1,77 @@
 #ifndef LIST_H
 #define LIST_H
 
+#include <inttypes.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
 
-#define CRINGE_MODE
+#ifndef NO_CRINGE_MODE
+    #define CRINGE_MODE
+#endif
+
+#ifndef LIST_INDEX_BITS
+    #define LIST_INDEX_BITS 64
+#endif
+
+// Operation counters in list_t, compiled out unless enabled
+#ifndef LIST_STATS
+    #define LIST_STATS 0
+#endif
 
 namespace list
 {
+    #if   LIST_INDEX_BITS == 16
+        typedef uint16_t index_t;
+        #define LIST_IDX_FMT PRIu16
+    #elif LIST_INDEX_BITS == 32
+        typedef uint32_t index_t;
+        #define LIST_IDX_FMT PRIu32
+    #elif LIST_INDEX_BITS == 64
+        typedef size_t index_t;
+        #define LIST_IDX_FMT "zu"
+    #else
+        #error "LIST_INDEX_BITS must be 16, 32 or 64"
+    #endif
+
+    // Top index bit tags free cells, so capacity stays below it
+    const size_t MAX_CAPACITY = ((size_t) 1 << (LIST_INDEX_BITS - 1)) - 1;
+
+    // Free cells keep the previous free cell in prev_arr, tagged with FREE_FLAG
+    const index_t FREE_FLAG  = MAX_CAPACITY + 1;
+    const size_t  INDEX_MASK = MAX_CAPACITY;
+
+    _Pragma ("GCC diagnostic push")
+    _Pragma ("GCC diagnostic ignored \"-Wuseless-cast\"")
+    inline index_t to_index (size_t index)
+    {
+        return (index_t) index;
+    }
+    _Pragma ("GCC diagnostic pop")
+
+    struct order_index_t;
+    struct allocator_t;
+
+    struct op_counters_t
+    {
+        size_t inserts;
+        size_t removes;
+        size_t get_iters;
+        size_t get_iter_hops;
+        size_t resizes;
+        size_t resize_bytes;
+        size_t linearises;
+        size_t linearise_ns;
+    };
+
     struct list_t
     {
-        void   *data_arr;
-        size_t *prev_arr;
-        size_t *next_arr;
+        void    *data_arr;
+        index_t *prev_arr;
+        index_t *next_arr;
 
-        size_t free_head;
-        size_t free_back;
+        index_t free_head;
+        index_t free_back;
         
         size_t obj_size;
         size_t reserved;
@@ -25,10 +80,23 @@ namespace list
 
         bool is_sorted;
 
+        order_index_t *order_index;
+
+        size_t compact_pos;
+        size_t compact_budget;
+
+        bool auto_shrink;
+
+        const allocator_t *allocator;
+
+    #if LIST_STATS
+        mutable op_counters_t counters;
+    #endif
+
         void (*print_func)(void *elem, FILE *stream);
     };
 
-    typedef uint8_t err_flags; 
+    typedef uint16_t err_flags; 
 
     enum err_t {
         OK                  = 0,
@@ -38,11 +106,18 @@ namespace list
         INVALID_CAPACITY    = 1 << 3,
         INVALID_SIZE        = 1 << 4,
         BROKEN_DATA_LOOP    = 1 << 5,
-        BROKEN_FREE_LOOP    = 1 << 6
+        BROKEN_FREE_LOOP    = 1 << 6,
+        CAPACITY_OVERFLOW   = 1 << 7,
+        IO_ERROR            = 1 << 8,
+        BAD_FORMAT          = 1 << 9
     };
 
+    /**
+     * @brief allocator == nullptr means libc heap, otherwise it must outlive the list
+     */
     err_t ctor (list_t *list, size_t obj_size, size_t reserved,
-                        void (*print_func)(void *elem, FILE *stream));
+                        void (*print_func)(void *elem, FILE *stream),
+                        const allocator_t *allocator = nullptr);
 
 
     void dtor (list_t *list);
@@ -50,6 +125,12 @@ namespace list
     [[nodiscard]]
     err_flags verify (const list_t *list);
 
+    /**
+     * @brief O(1) check: header fields, null cell and links around index
+     */
+    [[nodiscard]]
+    err_flags verify_local (const list_t *list, size_t index);
+
     void print_errs (err_flags flags, FILE *file, const char *prefix);
 
     ssize_t insert_after (list_t *list, size_t index, const void *elem);
@@ -60,6 +141,34 @@ namespace list
 
     ssize_t push_back  (list_t *list, const void *elem);
 
+    /**
+     * @brief Inserts count elements from contiguous array after index.
+     *        Capacity is reserved once and the run is spliced in with one link fix-up.
+     *
+     * @return Index of the first inserted cell or -1
+     */
+    ssize_t insert_range_after (list_t *list, size_t index, const void *elems, size_t count);
+
+    ssize_t push_back_n (list_t *list, const void *elems, size_t count);
+
+    /**
+     * @brief Moves elements [first, last] of src after dst_pos in dst.
+     *        Inside one list it's O(1) relink, between lists payloads are copied
+     *        in contiguous runs and src cells go to its free list with one splice.
+     *        Moved cells change their indexes when dst != src.
+     */
+    err_t splice (list_t *dst, size_t dst_pos, list_t *src, size_t first, size_t last);
+
+    /**
+     * @brief Moves all elements after index to the back of tail
+     */
+    err_t split_after (list_t *list, size_t index, list_t *tail);
+
+    /**
+     * @brief Moves all elements of src to the back of dst
+     */
+    err_t concat (list_t *dst, list_t *src);
+
     void get (list_t *list, size_t index, void *elem);
 
     void remove (list_t *list, size_t index, void *elem);
@@ -74,32 +183,237 @@ namespace list
 
     size_t get_iter (const list_t *list, size_t index);
 
+    /**
+     * @brief Calls func (elem, ctx) for every element in list order with
+     *        prefetching, see for_each in list_iterator.h for typed callbacks
+     */
+    void visit (list_t *list, void (*func)(void *elem, void *ctx), void *ctx);
+
+    /**
+     * @brief Enables order-statistic index, get_iter on unsorted list becomes O(log n)
+     */
+    err_t enable_order_index  (list_t *list);
+    void  disable_order_index (list_t *list);
+
+    /**
+     * @brief Changes capacity. Shrinking moves live cells to the low indexes
+     *        first, so held indexes change; capacity below size is an error.
+     */
     err_t resize (list_t *list, size_t new_capacity, bool linearise = false);
 
-    err_t sort (list_t *list);
+    /**
+     * @brief Shrinks capacity down to size
+     */
+    err_t shrink_to_fit (list_t *list);
+
+    /**
+     * @brief Halves capacity (not below reserved) when remove leaves the list
+     *        a quarter full. Cells are moved, so held indexes may change.
+     */
+    void set_auto_shrink (list_t *list, bool enable);
+
+    /**
+     * @brief Linearises storage order in place, use_copy switches to the old
+     *        path that copies payloads into a freshly allocated buffer
+     */
+    err_t sort (list_t *list, bool use_copy = false);
+
+    /**
+     * @brief Links cells 1..size as elements in storage order and the rest as
+     *        free list, payloads stay in place. For code that fills cells directly.
+     */
+    void relink_linear (list_t *list);
+
+    /**
+     * @brief Linearises storage with threads workers (0 - one per hardware thread).
+     *        Ranks come from a parallel ruling set walk, payloads are copied to
+     *        a new buffer and links rebuilt in parallel. Small lists use sort.
+     */
+    err_t sort_parallel (list_t *list, size_t threads = 0);
+
+    /**
+     * @brief Stable merge sort by cmp (as in qsort). Only links change, payloads
+     *        stay in their cells unless linearise moves storage to the new order.
+     */
+    err_t sort_by (list_t *list, int (*cmp)(const void *a, const void *b), bool linearise = false);
+
+    /**
+     * @brief Stable LSD radix sort by unsigned key of each element, O(n) extra memory.
+     *        Signed keys sort right with the sign bit flipped.
+     */
+    err_t sort_by_key (list_t *list, uint64_t (*key)(const void *elem), bool linearise = false);
+
+    /**
+     * @brief Moves at most budget cells towards physical order == logical order.
+     *        Moved cells change their indexes.
+     *
+     * @return true if list became linearised
+     */
+    bool compact_step (list_t *list, size_t budget);
+
+    /**
+     * @brief Runs compact_step with given budget on every insert/remove (0 disables).
+     *        insert_after returns the index after compaction, other held indexes may move.
+     */
+    void set_compact_budget (list_t *list, size_t budget);
+
+    /**
+     * @brief Streams list to file: linearised elements in logical order by default,
+     *        raw == true writes cell arrays with links as they are.
+     *        Data goes in checksummed blocks of about 1 MiB.
+     */
+    err_t save (const list_t *list, FILE *stream, bool raw = false);
+
+    /**
+     * @brief Constructs list from save output. Linearised snapshot is read with
+     *        one fread per block, raw one is checked with verify after checksums.
+     */
+    err_t load (list_t *list, FILE *stream, size_t obj_size,
+                void (*print_func)(void *elem, FILE *stream),
+                const allocator_t *allocator = nullptr);
+
+    struct stats_t
+    {
+        op_counters_t ops;
+
+        size_t live_bytes;
+        size_t free_bytes;
+        size_t capacity_bytes;
+
+        double locality;            ///< share of next links to the adjacent cell, 1 when linear
+        double free_fragmentation;  ///< share of free list links that jump between cells
+    };
+
+    /**
+     * @brief Counters (zero without LIST_STATS) plus O(n) memory and layout scan
+     */
+    stats_t stats (const list_t *list);
+    void    reset_stats (list_t *list);
 
     const char *err_to_str (const err_t err);
 
-    void dump (const list_t *list, FILE *stream = stdout);
+    enum dump_mode_t
+    {
+        DUMP_ALL     = 0,   ///< every cell from 0 to capacity
+        DUMP_CELLS   = 1,   ///< cells [center - radius, center + radius]
+        DUMP_LOGICAL = 2,   ///< elements at positions [center - radius, center + radius]
+        DUMP_BROKEN  = 3    ///< cells failing link checks, radius cells around each
+    };
+
+    struct dump_window_t
+    {
+        dump_mode_t mode;
+        size_t      center;
+        size_t      radius;
+    };
+
+    /**
+     * @brief Window used by graph_dump and by dump without explicit window.
+     *        Null cell is always shown, skipped cells are summarised by ranges.
+     */
+    void set_dump_window (dump_window_t window);
+
+    void dump (const list_t *list, FILE *stream = stdout, const dump_window_t *window = nullptr);
+    /**
+     * @brief Copies list arrays and queues rendering (.grv, dot, html log entry)
+     *        to dump workers, with 0 workers renders right away
+     */
     void graph_dump (const list::list_t *list, const char *reason_fmt, ...);
+
+    /**
+     * @brief Number of background render threads, 0 renders in the caller (default 1)
+     */
+    void set_dump_workers (size_t workers);
+
+    /**
+     * @brief At most max_pending dumps wait for a worker, the oldest is dropped first.
+     *        A dump within min_interval_ms of the previous one replaces it if it still waits.
+     */
+    void set_dump_limits (size_t max_pending, size_t min_interval_ms);
+
+    /**
+     * @brief Waits until every queued dump is rendered and logged
+     */
+    void graph_dump_flush ();
+
+    struct dump_stats_t
+    {
+        size_t requested;
+        size_t rendered;
+        size_t dropped;
+    };
+
+    dump_stats_t graph_dump_stats ();
+}
+
+// ----------------------------------------------------------------------------
+// Check levels for list_assert / list_assert_cell:
+//  NONE    - no checks
+//  LOCAL   - O(1): header fields and links around touched cell
+//  SAMPLED - LOCAL + full verify every LIST_CHECK_PERIOD-th list_assert
+//  FULL    - full verify on every list_assert
+// ----------------------------------------------------------------------------
+
+#define LIST_CHECK_NONE    0
+#define LIST_CHECK_LOCAL   1
+#define LIST_CHECK_SAMPLED 2
+#define LIST_CHECK_FULL    3
+
+#ifndef LIST_CHECK_LEVEL
+    #ifndef NDEBUG
+        #define LIST_CHECK_LEVEL LIST_CHECK_FULL
+    #else
+        #define LIST_CHECK_LEVEL LIST_CHECK_NONE
+    #endif
+#endif
+
+#ifndef LIST_CHECK_PERIOD
+    #define LIST_CHECK_PERIOD 1024
+#endif
+
+namespace list
+{
+    // Per thread counter: lists used from several threads don't share it
+    inline bool sample_verify ()
+    {
+        thread_local size_t tick = 0;
+        return ++tick % LIST_CHECK_PERIOD == 0;
+    }
+}
+
+#define _list_check(lst, expr)                                      \
+{                                                                   \
+    list::err_flags check_res = (expr);                             \
+    if (check_res != list::OK)                                      \
+    {                                                               \
+        log(log::ERR,                                               \
+            "Invalid list with errors: ");                          \
+        list::print_errs (check_res, get_log_stream(), "\t-> ");    \
+        list::dump (lst, get_log_stream());                         \
+        fflush (get_log_stream());                                  \
+        assert (0 && "Invalid list");                               \
+        abort ();                                                   \
+    }                                                               \
 }
 
-#ifndef NDEBUG
-    #define list_assert(list)                                       \
+#if LIST_CHECK_LEVEL >= LIST_CHECK_FULL
+    #define list_assert(lst)             _list_check (lst, list::verify (lst))
+    #define list_assert_cell(lst, index) {;}
+#elif LIST_CHECK_LEVEL == LIST_CHECK_SAMPLED
+    #define list_assert(lst)                                        \
     {                                                               \
-        list::err_flags check_res = list::verify (list);                  \
-        if (check_res != list::OK)                                 \
-        {                                                           \
-            log(log::ERR,                                           \
-                "Invalid list with errors: ");                      \
-            list::print_errs (check_res, get_log_stream(), "\t-> ");\
-            list::dump (list, get_log_stream());                    \
-            fflush (get_log_stream());                              \
-            assert (0 && "Invalid list");                           \
-        }                                                           \
+        if (list::sample_verify ())                                 \
+            _list_check (lst, list::verify (lst))                   \
+        else                                                        \
+            _list_check (lst, list::verify_local (lst, 0))          \
     }
+    #define list_assert_cell(lst, index) _list_check (lst, list::verify_local (lst, index))
+#elif LIST_CHECK_LEVEL == LIST_CHECK_LOCAL
+    #define list_assert(lst)             _list_check (lst, list::verify_local (lst, 0))
+    #define list_assert_cell(lst, index) _list_check (lst, list::verify_local (lst, index))
 #else
-    #define list_assert(list) {;}    
+    #define list_assert(lst)             {;}
+    #define list_assert_cell(lst, index) {;}
 #endif
 
 #endif
\ No newline at end of file
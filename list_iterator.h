@@ -0,0 +1,263 @@
+#ifndef LIST_ITERATOR_H
+#define LIST_ITERATOR_H
+
+#include <assert.h>
+#include <stddef.h>
+
+#include <iterator>
+#include <type_traits>
+
+#include "lib/log.h"
+#include "list.h"
+#include "typed_list.h"
+
+// ----------------------------------------------------------------------------
+// Bidirectional iterators over list_t and typed_list. The list is verified
+// once when a view (or begin of a typed list) is made, steps read next_arr /
+// prev_arr directly. end () is the null cell, so --end () is the tail.
+// Iterators hold the list, not its arrays: growth keeps them valid, removing
+// a cell invalidates iterators to it, sort and compaction invalidate all.
+// ----------------------------------------------------------------------------
+
+namespace list
+{
+    namespace detail
+    {
+        template <typename T>
+        T *cells_of (const list_t *list)
+        {
+            return (T *) list->data_arr;
+        }
+
+        template <typename T, typename IndexT>
+        T *cells_of (const typed_list<std::remove_const_t<T>, IndexT> *list)
+        {
+            return list->data_arr;
+        }
+    }
+
+    template <typename ListT, typename T>
+    struct list_iterator
+    {
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::remove_cv_t<T>             value_type;
+        typedef ptrdiff_t                       difference_type;
+        typedef T                              *pointer;
+        typedef T                              &reference;
+
+        ListT  *owner = nullptr;
+        size_t  cell  = 0;      ///< cell index, 0 is end
+
+        reference operator*  () const { return detail::cells_of<T> (owner)[cell]; }
+        pointer   operator-> () const { return &detail::cells_of<T> (owner)[cell]; }
+
+        list_iterator &operator++ ()
+        {
+            cell = owner->next_arr[cell];
+            return *this;
+        }
+
+        list_iterator &operator-- ()
+        {
+            cell = owner->prev_arr[cell];
+            return *this;
+        }
+
+        list_iterator operator++ (int)
+        {
+            list_iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        list_iterator operator-- (int)
+        {
+            list_iterator old = *this;
+            --*this;
+            return old;
+        }
+
+        bool operator== (const list_iterator &other) const
+        {
+            assert (owner == other.owner && "iterators of different lists");
+            return cell == other.cell;
+        }
+    };
+
+    template <typename ListT, typename T>
+    struct list_view
+    {
+        typedef list_iterator<ListT, T> iterator;
+
+        ListT *owner = nullptr;
+
+        iterator begin () const { return {owner, owner->next_arr[0]}; }
+        iterator end   () const { return {owner, 0}; }
+
+        size_t size  () const { return owner->size; }
+        bool   empty () const { return owner->size == 0; }
+    };
+
+    // ------------------------------------------------------------------------
+
+    /**
+     * @brief Range over list_t elements as T, T must match obj_size
+     */
+    template <typename T>
+    list_view<list_t, T> view (list_t *list)
+    {
+        assert (list != nullptr && "pointer can't be nullptr");
+        assert (list->obj_size == sizeof (T) && "element type doesn't match obj_size");
+        list_assert (list);
+
+        return {list};
+    }
+
+    template <typename T>
+    list_view<const list_t, const T> view (const list_t *list)
+    {
+        assert (list != nullptr && "pointer can't be nullptr");
+        assert (list->obj_size == sizeof (T) && "element type doesn't match obj_size");
+        list_assert (list);
+
+        return {list};
+    }
+
+    template <typename T, typename IndexT>
+    list_view<typed_list<T, IndexT>, T> view (typed_list<T, IndexT> *list)
+    {
+        assert (list != nullptr && "pointer can't be nullptr");
+        list_assert (list);
+
+        return {list};
+    }
+
+    template <typename T, typename IndexT>
+    list_view<const typed_list<T, IndexT>, const T> view (const typed_list<T, IndexT> *list)
+    {
+        assert (list != nullptr && "pointer can't be nullptr");
+        list_assert (list);
+
+        return {list};
+    }
+
+    // Range-for straight over a typed list: for (T &elem : typed)
+    template <typename T, typename IndexT>
+    list_iterator<typed_list<T, IndexT>, T> begin (typed_list<T, IndexT> &list)
+    {
+        return list::view (&list).begin ();
+    }
+
+    template <typename T, typename IndexT>
+    list_iterator<typed_list<T, IndexT>, T> end (typed_list<T, IndexT> &list)
+    {
+        return {&list, 0};
+    }
+
+    template <typename T, typename IndexT>
+    list_iterator<const typed_list<T, IndexT>, const T> begin (const typed_list<T, IndexT> &list)
+    {
+        return list::view (&list).begin ();
+    }
+
+    template <typename T, typename IndexT>
+    list_iterator<const typed_list<T, IndexT>, const T> end (const typed_list<T, IndexT> &list)
+    {
+        return {&list, 0};
+    }
+
+    // ------------------------------------------------------------------------
+    // for_each: sorted lists are a linear sweep of data_arr, otherwise links
+    // are followed with the link and payload of the cell two steps ahead
+    // prefetched, so the dependent load chain overlaps with the callback.
+    // ------------------------------------------------------------------------
+
+    namespace detail
+    {
+        template <typename IndexT, typename Visit>
+        void walk_cells (const IndexT *next_arr, size_t size, bool is_sorted, Visit &&visit)
+        {
+            size_t cur = next_arr[0];
+
+            if (is_sorted)
+            {
+                for (size_t i = cur; i < cur + size; ++i)
+                {
+                    visit (i, i);
+                }
+                return;
+            }
+
+            size_t after = (cur != 0) ? next_arr[cur] : 0;
+
+            while (cur != 0)
+            {
+                size_t ahead = next_arr[after];
+
+                __builtin_prefetch (&next_arr[ahead]);
+                visit (cur, ahead);
+
+                cur   = after;
+                after = ahead;
+            }
+        }
+    }
+
+    /**
+     * @brief Calls func (T &elem) for every element in list order
+     */
+    template <typename T, typename Func>
+    void for_each (list_t *list, Func &&func)
+    {
+        assert (list != nullptr && "pointer can't be nullptr");
+        assert (list->obj_size == sizeof (T) && "element type doesn't match obj_size");
+        list_assert (list);
+
+        T *cells = detail::cells_of<T> (list);
+
+        detail::walk_cells (list->next_arr, list->size, list->is_sorted,
+            [cells, &func] (size_t cell, size_t ahead)
+            {
+                __builtin_prefetch (&cells[ahead]);
+                func (cells[cell]);
+            });
+    }
+
+    template <typename T, typename Func>
+    void for_each (const list_t *list, Func &&func)
+    {
+        assert (list != nullptr && "pointer can't be nullptr");
+        assert (list->obj_size == sizeof (T) && "element type doesn't match obj_size");
+        list_assert (list);
+
+        const T *cells = detail::cells_of<const T> (list);
+
+        detail::walk_cells (list->next_arr, list->size, list->is_sorted,
+            [cells, &func] (size_t cell, size_t ahead)
+            {
+                __builtin_prefetch (&cells[ahead]);
+                func (cells[cell]);
+            });
+    }
+
+    template <typename T, typename IndexT, typename Func>
+    void for_each (typed_list<T, IndexT> *list, Func &&func)
+    {
+        assert (list != nullptr && "pointer can't be nullptr");
+        list_assert (list);
+
+        T *cells = list->data_arr;
+
+        detail::walk_cells (list->next_arr, list->size, list->is_sorted,
+            [cells, &func] (size_t cell, size_t ahead)
+            {
+                __builtin_prefetch (&cells[ahead]);
+                func (cells[cell]);
+            });
+    }
+
+    static_assert (std::bidirectional_iterator<list_iterator<list_t, int>>);
+    static_assert (std::bidirectional_iterator<list_iterator<const typed_list<int>, const int>>);
+}
+
+#endif //LIST_ITERATOR_H
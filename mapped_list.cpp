@@ -0,0 +1,377 @@
+#include <assert.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "lib/log.h"
+#include "allocator.h"
+#include "mapped_list.h"
+
+// ----------------------------------------------------------------------------
+// STATIC DEFINITIONS
+// ----------------------------------------------------------------------------
+
+static const char MAP_MAGIC[8] = {'L', 'I', 'S', 'T', 'M', 'A', 'P', '\0'};
+
+// Mapped arrays are never freed or resized in place: growth copies them out
+// to heap for private mapping and fails for shared one (file layout is fixed),
+// everything else is released by munmap in close
+struct mapping_t
+{
+    list::allocator_t alloc;
+
+    char   *base;
+    size_t  len;
+    bool    shared;
+};
+
+static void *map_alloc   (void *ctx, size_t size);
+static void *map_realloc (void *ctx, void *ptr, size_t old_size, size_t new_size);
+static void  map_free    (void *ctx, void *ptr, size_t size);
+static bool  in_mapping  (const mapping_t *map, const void *ptr);
+static void  sync_region (const mapping_t *map, uint64_t offset, const void *ptr, size_t size);
+
+static size_t      align_up     (size_t size);
+static list::err_t write_region (FILE *file, const void *ptr, size_t size, size_t offset);
+static list::err_t check_header (const list::map_header_t *header, size_t len, size_t obj_size);
+
+// ----------------------------------------------------------------------------
+// PUBLIC FUNCTIONS
+// ----------------------------------------------------------------------------
+
+list::err_t list::mapped::save (const list_t *list, const char *path)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+    assert (path != nullptr && "pointer can't be nullptr");
+    list_assert (list);
+
+    size_t cells = list->capacity + 1;
+
+    map_header_t header = {};
+    memcpy (header.magic, MAP_MAGIC, sizeof (MAP_MAGIC));
+
+    header.version     = MAP_VERSION;
+    header.index_bits  = LIST_INDEX_BITS;
+    header.obj_size    = list->obj_size;
+    header.capacity    = list->capacity;
+    header.size        = list->size;
+    header.free_head   = list->free_head;
+    header.free_back   = list->free_back;
+    header.is_sorted   = list->is_sorted;
+    header.data_offset = align_up (sizeof (header));
+    header.next_offset = align_up (header.data_offset + cells * list->obj_size);
+    header.prev_offset = align_up (header.next_offset + cells * sizeof (index_t));
+
+    FILE *file = fopen (path, "wb");
+    if (file == nullptr)
+    {
+        log (log::ERR, "Failed to open '%s' for writing", path);
+        return list::IO_ERROR;
+    }
+
+    err_t res = write_region (file, &header, sizeof (header), 0);
+
+    if (res == list::OK)
+    {
+        res = write_region (file, list->data_arr, cells * list->obj_size, header.data_offset);
+    }
+    if (res == list::OK)
+    {
+        res = write_region (file, list->next_arr, cells * sizeof (index_t), header.next_offset);
+    }
+    if (res == list::OK)
+    {
+        res = write_region (file, list->prev_arr, cells * sizeof (index_t), header.prev_offset);
+    }
+
+    if (fclose (file) != 0 && res == list::OK)
+    {
+        res = list::IO_ERROR;
+    }
+
+    if (res != list::OK)
+    {
+        log (log::ERR, "Failed to write list to '%s'", path);
+    }
+
+    return res;
+}
+
+// ----------------------------------------------------------------------------
+
+list::err_t list::mapped::open (list_t *list, const char *path, size_t obj_size, bool shared,
+                                void (*print_func)(void *elem, FILE *stream))
+{
+    assert (list       != nullptr && "pointer can't be nullptr");
+    assert (path       != nullptr && "pointer can't be nullptr");
+    assert (print_func != nullptr && "pointer can't be nullptr");
+    assert (obj_size > 0 && "Object size can't be less than 1");
+
+    int fd = ::open (path, shared ? O_RDWR : O_RDONLY);
+    if (fd < 0)
+    {
+        log (log::ERR, "Failed to open '%s'", path);
+        return list::IO_ERROR;
+    }
+
+    struct stat st = {};
+    if (fstat (fd, &st) != 0 || (size_t) st.st_size < sizeof (map_header_t))
+    {
+        log (log::ERR, "'%s' is too small for list header", path);
+        ::close (fd);
+        return list::BAD_FORMAT;
+    }
+
+    size_t len  = (size_t) st.st_size;
+    void  *base = mmap (nullptr, len, PROT_READ | PROT_WRITE,
+                        shared ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+    ::close (fd);
+
+    if (base == MAP_FAILED)
+    {
+        log (log::ERR, "Failed to map '%s'", path);
+        return list::IO_ERROR;
+    }
+
+    const map_header_t *header = (const map_header_t *) base;
+
+    err_t res = check_header (header, len, obj_size);
+    if (res != list::OK)
+    {
+        log (log::ERR, "'%s' is not a valid list file", path);
+        munmap (base, len);
+        return res;
+    }
+
+    mapping_t *map = (mapping_t *) calloc (1, sizeof (mapping_t));
+    if (map == nullptr)
+    {
+        log (log::ERR, "OOM");
+        munmap (base, len);
+        return list::OOM;
+    }
+
+    map->alloc  = {map, map_alloc, map_realloc, map_free};
+    map->base   = (char *) base;
+    map->len    = len;
+    map->shared = shared;
+
+    list->data_arr  = map->base + header->data_offset;
+    list->next_arr  = (index_t *) (map->base + header->next_offset);
+    list->prev_arr  = (index_t *) (map->base + header->prev_offset);
+    list->allocator = &map->alloc;
+
+    _Pragma ("GCC diagnostic push")
+    _Pragma ("GCC diagnostic ignored \"-Wuseless-cast\"")
+    list->free_head = (index_t) header->free_head;
+    list->free_back = (index_t) header->free_back;
+    _Pragma ("GCC diagnostic pop")
+    list->obj_size  = obj_size;
+    list->reserved  = 0;
+    list->capacity  = header->capacity;
+    list->size      = header->size;
+    list->is_sorted = header->is_sorted != 0;
+
+    list->order_index    = nullptr;
+    list->compact_pos    = list->is_sorted ? list->size + 1 : 1;
+    list->compact_budget = 0;
+    list->auto_shrink    = false;
+    list->print_func     = print_func;
+
+    list::reset_stats (list);
+
+    // Only the header and null cell are touched, the rest is faulted in lazily
+    if (list::verify_local (list, 0) != list::OK)
+    {
+        log (log::ERR, "'%s' has broken list header", path);
+        list::mapped::close (list);
+        return list::BAD_FORMAT;
+    }
+
+    return list::OK;
+}
+
+// ----------------------------------------------------------------------------
+
+void list::mapped::close (list_t *list)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+    assert (list->allocator != nullptr && list->allocator->free == map_free && "list is not mapped");
+
+    mapping_t *map = (mapping_t *) list->allocator->ctx;
+
+    if (map->shared)
+    {
+        map_header_t *header = (map_header_t *) map->base;
+        size_t        cells  = list->capacity + 1;
+
+        assert (list->capacity <= header->capacity && "shared list outgrew its file");
+
+        // Copying sort moves data to heap, it is written back to its region
+        sync_region (map, header->data_offset, list->data_arr, cells * list->obj_size);
+        sync_region (map, header->next_offset, list->next_arr, cells * sizeof (index_t));
+        sync_region (map, header->prev_offset, list->prev_arr, cells * sizeof (index_t));
+
+        header->capacity  = list->capacity;
+        header->size      = list->size;
+        header->free_head = list->free_head;
+        header->free_back = list->free_back;
+        header->is_sorted = list->is_sorted;
+    }
+
+    list::dtor (list);
+
+    munmap (map->base, map->len);
+    free (map);
+
+    list->allocator = nullptr;
+}
+
+// ----------------------------------------------------------------------------
+// STATIC FUNCTIONS
+// ----------------------------------------------------------------------------
+
+static void *map_alloc (void *, size_t size)
+{
+    return malloc (size);
+}
+
+static void *map_realloc (void *ctx, void *ptr, size_t old_size, size_t new_size)
+{
+    assert (ctx != nullptr && "pointer can't be nullptr");
+
+    mapping_t *map = (mapping_t *) ctx;
+
+    if (!in_mapping (map, ptr))
+    {
+        return realloc (ptr, new_size);
+    }
+
+    if (new_size <= old_size)
+    {
+        return ptr;
+    }
+
+    // Links and header in the file must stay consistent, so shared list can't grow
+    if (map->shared)
+    {
+        log (log::ERR, "Shared mapped list can't grow past its file capacity");
+        return nullptr;
+    }
+
+    void *new_ptr = malloc (new_size);
+    if (new_ptr != nullptr)
+    {
+        memcpy (new_ptr, ptr, old_size);
+    }
+
+    return new_ptr;
+}
+
+static void map_free (void *ctx, void *ptr, size_t)
+{
+    assert (ctx != nullptr && "pointer can't be nullptr");
+
+    if (!in_mapping ((mapping_t *) ctx, ptr))
+    {
+        free (ptr);
+    }
+}
+
+static bool in_mapping (const mapping_t *map, const void *ptr)
+{
+    assert (map != nullptr && "pointer can't be nullptr");
+
+    const char *p = (const char *) ptr;
+
+    return p >= map->base && p < map->base + map->len;
+}
+
+static void sync_region (const mapping_t *map, uint64_t offset, const void *ptr, size_t size)
+{
+    assert (map != nullptr && "pointer can't be nullptr");
+    assert (ptr != nullptr && "pointer can't be nullptr");
+
+    if (!in_mapping (map, ptr))
+    {
+        memcpy (map->base + offset, ptr, size);
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+static size_t align_up (size_t size)
+{
+    return (size + list::MAP_ALIGN - 1) / list::MAP_ALIGN * list::MAP_ALIGN;
+}
+
+static list::err_t write_region (FILE *file, const void *ptr, size_t size, size_t offset)
+{
+    assert (file != nullptr && "pointer can't be nullptr");
+    assert (ptr  != nullptr && "pointer can't be nullptr");
+
+    long pos = ftell (file);
+    if (pos < 0 || (size_t) pos > offset)
+    {
+        return list::IO_ERROR;
+    }
+
+    // Zero padding up to region start
+    static const char zeros[64] = {};
+    for (size_t left = offset - (size_t) pos; left > 0; )
+    {
+        size_t chunk = (left < sizeof (zeros)) ? left : sizeof (zeros);
+        if (fwrite (zeros, 1, chunk, file) != chunk)
+        {
+            return list::IO_ERROR;
+        }
+        left -= chunk;
+    }
+
+    if (fwrite (ptr, 1, size, file) != size)
+    {
+        return list::IO_ERROR;
+    }
+
+    return list::OK;
+}
+
+static list::err_t check_header (const list::map_header_t *header, size_t len, size_t obj_size)
+{
+    assert (header != nullptr && "pointer can't be nullptr");
+
+    if (memcmp (header->magic, MAP_MAGIC, sizeof (MAP_MAGIC)) != 0 ||
+        header->version    != list::MAP_VERSION ||
+        header->index_bits != LIST_INDEX_BITS   ||
+        header->obj_size   != obj_size)
+    {
+        return list::BAD_FORMAT;
+    }
+
+    if (header->capacity > list::MAX_CAPACITY || header->size > header->capacity ||
+        header->free_head > header->capacity  || header->free_back > header->capacity)
+    {
+        return list::INVALID_CAPACITY;
+    }
+
+    size_t cells = header->capacity + 1;
+
+    struct { uint64_t offset; size_t elem; } regions[] = {
+        {header->data_offset, obj_size},
+        {header->next_offset, sizeof (list::index_t)},
+        {header->prev_offset, sizeof (list::index_t)},
+    };
+
+    for (size_t i = 0; i < sizeof (regions) / sizeof (regions[0]); ++i)
+    {
+        if (regions[i].offset % list::MAP_ALIGN != 0 || regions[i].offset > len ||
+            cells > (len - regions[i].offset) / regions[i].elem)
+        {
+            return list::BAD_FORMAT;
+        }
+    }
+
+    return list::OK;
+}
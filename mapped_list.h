@@ -0,0 +1,63 @@
+#ifndef MAPPED_LIST_H
+#define MAPPED_LIST_H
+
+#include <stdint.h>
+
+#include "list.h"
+
+// ----------------------------------------------------------------------------
+// On-disk list layout: header, then data_arr, next_arr and prev_arr regions,
+// each starting at MAP_ALIGN boundary. Arrays are stored as is (cells, links
+// and free list), so an opened file is used by next/prev/get without parsing.
+// ----------------------------------------------------------------------------
+
+namespace list
+{
+    const uint32_t MAP_VERSION = 1;
+    const size_t   MAP_ALIGN   = 4096;
+
+    struct map_header_t
+    {
+        char     magic[8];
+        uint32_t version;
+        uint32_t index_bits;
+
+        uint64_t obj_size;
+        uint64_t capacity;
+        uint64_t size;
+        uint64_t free_head;
+        uint64_t free_back;
+
+        uint64_t data_offset;
+        uint64_t next_offset;
+        uint64_t prev_offset;
+
+        uint8_t  is_sorted;
+        uint8_t  reserved[7];
+    };
+
+    namespace mapped
+    {
+        /**
+         * @brief Writes list to path in mappable layout
+         */
+        err_t save (const list_t *list, const char *path);
+
+        /**
+         * @brief Maps file and makes list on top of it, nothing is read until touched.
+         *        shared == true writes mutations through to the file, otherwise
+         *        they stay in a private copy-on-write mapping. Shared list can't
+         *        grow past the file capacity (OOM), private one moves arrays to
+         *        heap on growth, after that use save to persist it.
+         */
+        err_t open (list_t *list, const char *path, size_t obj_size, bool shared,
+                    void (*print_func)(void *elem, FILE *stream));
+
+        /**
+         * @brief Updates file header (shared mapping only) and unmaps the file
+         */
+        void close (list_t *list);
+    }
+}
+
+#endif //MAPPED_LIST_H
@@ -0,0 +1,426 @@
+#include <assert.h>
+#include <string.h>
+
+#include "lib/log.h"
+#include "order_index.h"
+
+// ----------------------------------------------------------------------------
+// STATIC DEFINITIONS
+// ----------------------------------------------------------------------------
+
+static void   update (list::order_index_t *idx, size_t node);
+static size_t merge  (list::order_index_t *idx, size_t a, size_t b);
+static void   split  (list::order_index_t *idx, size_t node, size_t pos,
+                      size_t *left_res, size_t *right_res);
+
+static size_t   cut_range (list::order_index_t *idx, size_t first, size_t last);
+static void     relabel   (list::order_index_t *idx, size_t a, size_t b, bool b_in_tree);
+static void     init_node (list::order_index_t *idx, size_t node);
+static uint32_t next_prio (list::order_index_t *idx);
+
+// ----------------------------------------------------------------------------
+// PUBLIC FUNCTIONS
+// ----------------------------------------------------------------------------
+
+list::err_t list::order::ctor (order_index_t *idx, size_t capacity, const allocator_t *allocator)
+{
+    assert (idx != nullptr && "pointer can't be nullptr");
+
+    size_t cells = capacity + 1;
+
+    idx->allocator = allocator;
+    idx->left      = (size_t *)   list::allocate (allocator, cells * sizeof (size_t));
+    idx->right     = (size_t *)   list::allocate (allocator, cells * sizeof (size_t));
+    idx->parent    = (size_t *)   list::allocate (allocator, cells * sizeof (size_t));
+    idx->count     = (size_t *)   list::allocate (allocator, cells * sizeof (size_t));
+    idx->prio      = (uint32_t *) list::allocate (allocator, cells * sizeof (uint32_t));
+    idx->root      = 0;
+    idx->capacity  = capacity;
+    idx->seed      = 0x9E3779B9u;
+
+    if (idx->left  == nullptr || idx->right == nullptr || idx->parent == nullptr ||
+        idx->count == nullptr || idx->prio  == nullptr)
+    {
+        log (log::ERR, "OOM");
+        list::order::dtor (idx);
+        return list::OOM;
+    }
+
+    // Nil node
+    init_node (idx, 0);
+    idx->count[0] = 0;
+
+    return list::OK;
+}
+
+void list::order::dtor (order_index_t *idx)
+{
+    assert (idx != nullptr && "pointer can't be nullptr");
+
+    size_t cells = idx->capacity + 1;
+
+    list::deallocate (idx->allocator, idx->left,   cells * sizeof (size_t));
+    list::deallocate (idx->allocator, idx->right,  cells * sizeof (size_t));
+    list::deallocate (idx->allocator, idx->parent, cells * sizeof (size_t));
+    list::deallocate (idx->allocator, idx->count,  cells * sizeof (size_t));
+    list::deallocate (idx->allocator, idx->prio,   cells * sizeof (uint32_t));
+}
+
+list::err_t list::order::resize (order_index_t *idx, size_t new_capacity)
+{
+    assert (idx != nullptr && "pointer can't be nullptr");
+
+    void  *arrays    [] = {idx->left, idx->right, idx->parent, idx->count, idx->prio};
+    size_t elem_sizes[] = {sizeof (size_t), sizeof (size_t), sizeof (size_t),
+                           sizeof (size_t), sizeof (uint32_t)};
+
+    bool resized = list::reallocate_arrays (idx->allocator, arrays, elem_sizes,
+                                            sizeof (arrays) / sizeof (arrays[0]),
+                                            idx->capacity + 1, new_capacity + 1);
+
+    idx->left   = (size_t *)   arrays[0];
+    idx->right  = (size_t *)   arrays[1];
+    idx->parent = (size_t *)   arrays[2];
+    idx->count  = (size_t *)   arrays[3];
+    idx->prio   = (uint32_t *) arrays[4];
+
+    if (!resized)
+    {
+        return list::OOM;
+    }
+
+    idx->capacity = new_capacity;
+
+    return list::OK;
+}
+
+// ----------------------------------------------------------------------------
+
+void list::order::build (order_index_t *idx, const list_t *list)
+{
+    assert (idx  != nullptr && "pointer can't be nullptr");
+    assert (list != nullptr && "pointer can't be nullptr");
+    assert (idx->capacity >= list->capacity && "index is smaller than list");
+
+    idx->root = 0;
+
+    size_t cell = list->next_arr[0];
+    for (size_t i = 0; i < list->size; ++i)
+    {
+        init_node (idx, cell);
+        idx->root = merge (idx, idx->root, cell);
+        cell = list->next_arr[cell];
+    }
+
+    idx->parent[idx->root] = 0;
+}
+
+// ----------------------------------------------------------------------------
+
+void list::order::insert_after (order_index_t *idx, size_t prev_cell, size_t cell)
+{
+    assert (idx != nullptr && "pointer can't be nullptr");
+    assert (cell != 0 && cell <= idx->capacity && "invalid cell");
+
+    size_t pos = (prev_cell == 0) ? 0 : list::order::rank (idx, prev_cell) + 1;
+
+    size_t left_part  = 0;
+    size_t right_part = 0;
+    split (idx, idx->root, pos, &left_part, &right_part);
+
+    init_node (idx, cell);
+    idx->root = merge (idx, merge (idx, left_part, cell), right_part);
+    idx->parent[idx->root] = 0;
+}
+
+void list::order::remove (order_index_t *idx, size_t cell)
+{
+    assert (idx != nullptr && "pointer can't be nullptr");
+    assert (cell != 0 && cell <= idx->capacity && "invalid cell");
+
+    size_t pos = list::order::rank (idx, cell);
+
+    size_t left_part  = 0;
+    size_t mid_part   = 0;
+    size_t right_part = 0;
+    split (idx, idx->root, pos,  &left_part, &right_part);
+    split (idx, right_part, 1,   &mid_part,  &right_part);
+
+    assert (mid_part == cell && "index is out of sync with list");
+
+    idx->root = merge (idx, left_part, right_part);
+    idx->parent[idx->root] = 0;
+}
+
+// ----------------------------------------------------------------------------
+
+void list::order::remove_range (order_index_t *idx, size_t first, size_t last)
+{
+    assert (idx != nullptr && "pointer can't be nullptr");
+
+    cut_range (idx, first, last);
+}
+
+void list::order::move_range (order_index_t *idx, size_t first, size_t last, size_t after)
+{
+    assert (idx != nullptr && "pointer can't be nullptr");
+
+    size_t range = cut_range (idx, first, last);
+    size_t pos   = (after == 0) ? 0 : list::order::rank (idx, after) + 1;
+
+    size_t left_part  = 0;
+    size_t right_part = 0;
+    split (idx, idx->root, pos, &left_part, &right_part);
+
+    idx->root = merge (idx, merge (idx, left_part, range), right_part);
+    idx->parent[idx->root] = 0;
+}
+
+// ----------------------------------------------------------------------------
+
+void list::order::move (order_index_t *idx, size_t from, size_t to)
+{
+    assert (idx != nullptr && "pointer can't be nullptr");
+
+    relabel (idx, from, to, false);
+}
+
+void list::order::swap (order_index_t *idx, size_t a, size_t b)
+{
+    assert (idx != nullptr && "pointer can't be nullptr");
+
+    relabel (idx, a, b, true);
+}
+
+// ----------------------------------------------------------------------------
+
+size_t list::order::kth (const order_index_t *idx, size_t pos)
+{
+    assert (idx != nullptr && "pointer can't be nullptr");
+    assert (pos < idx->count[idx->root] && "position out of bounds");
+
+    size_t node = idx->root;
+
+    while (true)
+    {
+        size_t left_count = idx->count[idx->left[node]];
+
+        if (pos < left_count)
+        {
+            node = idx->left[node];
+        }
+        else if (pos == left_count)
+        {
+            return node;
+        }
+        else
+        {
+            pos -= left_count + 1;
+            node = idx->right[node];
+        }
+    }
+}
+
+size_t list::order::rank (const order_index_t *idx, size_t cell)
+{
+    assert (idx != nullptr && "pointer can't be nullptr");
+
+    size_t res = idx->count[idx->left[cell]];
+
+    while (cell != idx->root)
+    {
+        size_t parent = idx->parent[cell];
+
+        if (idx->right[parent] == cell)
+        {
+            res += idx->count[idx->left[parent]] + 1;
+        }
+
+        cell = parent;
+    }
+
+    return res;
+}
+
+// ----------------------------------------------------------------------------
+// STATIC FUNCTIONS
+// ----------------------------------------------------------------------------
+
+static void update (list::order_index_t *idx, size_t node)
+{
+    assert (idx != nullptr && "pointer can't be nullptr");
+    assert (node != 0 && "can't update nil node");
+
+    size_t left  = idx->left[node];
+    size_t right = idx->right[node];
+
+    idx->count[node] = idx->count[left] + idx->count[right] + 1;
+
+    if (left  != 0) { idx->parent[left]  = node; }
+    if (right != 0) { idx->parent[right] = node; }
+}
+
+// ----------------------------------------------------------------------------
+
+static size_t merge (list::order_index_t *idx, size_t a, size_t b)
+{
+    assert (idx != nullptr && "pointer can't be nullptr");
+
+    if (a == 0) return b;
+    if (b == 0) return a;
+
+    if (idx->prio[a] > idx->prio[b])
+    {
+        idx->right[a] = merge (idx, idx->right[a], b);
+        update (idx, a);
+        return a;
+    }
+    else
+    {
+        idx->left[b] = merge (idx, a, idx->left[b]);
+        update (idx, b);
+        return b;
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+static void split (list::order_index_t *idx, size_t node, size_t pos,
+                   size_t *left_res, size_t *right_res)
+{
+    assert (idx       != nullptr && "pointer can't be nullptr");
+    assert (left_res  != nullptr && "pointer can't be nullptr");
+    assert (right_res != nullptr && "pointer can't be nullptr");
+
+    if (node == 0)
+    {
+        *left_res  = 0;
+        *right_res = 0;
+        return;
+    }
+
+    size_t left_count = idx->count[idx->left[node]];
+
+    if (pos <= left_count)
+    {
+        split (idx, idx->left[node], pos, left_res, &idx->left[node]);
+        update (idx, node);
+        *right_res = node;
+    }
+    else
+    {
+        split (idx, idx->right[node], pos - left_count - 1, &idx->right[node], right_res);
+        update (idx, node);
+        *left_res = node;
+    }
+
+    idx->parent[node] = 0;
+}
+
+// ----------------------------------------------------------------------------
+
+static size_t cut_range (list::order_index_t *idx, size_t first, size_t last)
+{
+    assert (idx != nullptr && "pointer can't be nullptr");
+
+    size_t from = list::order::rank (idx, first);
+    size_t to   = list::order::rank (idx, last);
+
+    assert (from <= to && "invalid range");
+
+    size_t left_part  = 0;
+    size_t mid_part   = 0;
+    size_t right_part = 0;
+    split (idx, idx->root, from,         &left_part, &right_part);
+    split (idx, right_part, to - from + 1, &mid_part,  &right_part);
+
+    idx->root = merge (idx, left_part, right_part);
+    idx->parent[idx->root] = 0;
+
+    return mid_part;
+}
+
+// ----------------------------------------------------------------------------
+
+// Node a gets label b and (if b_in_tree) node b gets label a
+static void relabel (list::order_index_t *idx, size_t a, size_t b, bool b_in_tree)
+{
+    assert (idx != nullptr && "pointer can't be nullptr");
+    assert (a != 0 && b != 0 && "can't relabel nil node");
+
+    #define _MAP(x) ((x) == a ? b : ((x) == b && b_in_tree ? a : (x)))
+
+    // Sides are taken before relinking, a and b may be siblings
+    bool a_is_left = idx->left[idx->parent[a]] == a;
+    bool b_is_left = b_in_tree && idx->left[idx->parent[b]] == b;
+
+    size_t   a_fields[4] = {_MAP (idx->left[a]), _MAP (idx->right[a]),
+                            _MAP (idx->parent[a]), idx->count[a]};
+    uint32_t a_prio      = idx->prio[a];
+
+    if (b_in_tree)
+    {
+        idx->left[a]   = _MAP (idx->left[b]);
+        idx->right[a]  = _MAP (idx->right[b]);
+        idx->parent[a] = _MAP (idx->parent[b]);
+        idx->count[a]  = idx->count[b];
+        idx->prio[a]   = idx->prio[b];
+    }
+
+    idx->left[b]   = a_fields[0];
+    idx->right[b]  = a_fields[1];
+    idx->parent[b] = a_fields[2];
+    idx->count[b]  = a_fields[3];
+    idx->prio[b]   = a_prio;
+
+    idx->root = _MAP (idx->root);
+
+    size_t nodes[2]   = {b, a};
+    bool   is_left[2] = {a_is_left, b_is_left};
+
+    for (size_t i = 0; i < (b_in_tree ? 2u : 1u); ++i)
+    {
+        size_t node   = nodes[i];
+        size_t parent = idx->parent[node];
+
+        if (idx->left[node]  != 0) { idx->parent[idx->left[node]]  = node; }
+        if (idx->right[node] != 0) { idx->parent[idx->right[node]] = node; }
+
+        if (parent == 0 || parent == a || parent == b)
+        {
+            continue;
+        }
+
+        if (is_left[i]) { idx->left[parent]  = node; }
+        else            { idx->right[parent] = node; }
+    }
+
+    #undef _MAP
+}
+
+// ----------------------------------------------------------------------------
+
+static void init_node (list::order_index_t *idx, size_t node)
+{
+    assert (idx != nullptr && "pointer can't be nullptr");
+
+    idx->left[node]   = 0;
+    idx->right[node]  = 0;
+    idx->parent[node] = 0;
+    idx->count[node]  = 1;
+    idx->prio[node]   = next_prio (idx);
+}
+
+static uint32_t next_prio (list::order_index_t *idx)
+{
+    assert (idx != nullptr && "pointer can't be nullptr");
+
+    // xorshift32, keeps rand () state untouched
+    uint32_t x = idx->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    idx->seed = x;
+
+    return x;
+}
@@ -0,0 +1,70 @@
+#ifndef ORDER_INDEX_H
+#define ORDER_INDEX_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "list.h"
+#include "allocator.h"
+
+// ----------------------------------------------------------------------------
+// Order-statistic index over the logical order of list cells.
+// Implicit treap: node i is cell i, node 0 is nil, position is subtree rank.
+// ----------------------------------------------------------------------------
+
+namespace list
+{
+    struct order_index_t
+    {
+        size_t   *left;
+        size_t   *right;
+        size_t   *parent;
+        size_t   *count;
+        uint32_t *prio;
+
+        size_t   root;
+        size_t   capacity;
+        uint32_t seed;
+
+        const allocator_t *allocator;
+    };
+
+    namespace order
+    {
+        /**
+         * @brief Arrays come from allocator (libc heap when nullptr), normally the list's one
+         */
+        err_t ctor (order_index_t *idx, size_t capacity, const allocator_t *allocator = nullptr);
+        void  dtor (order_index_t *idx);
+
+        err_t resize (order_index_t *idx, size_t new_capacity);
+
+        /**
+         * @brief Drops all nodes and rebuilds index from current list links
+         */
+        void build (order_index_t *idx, const list_t *list);
+
+        /**
+         * @brief Inserts cell right after prev_cell in logical order (prev_cell == 0 means front)
+         */
+        void insert_after (order_index_t *idx, size_t prev_cell, size_t cell);
+        void remove       (order_index_t *idx, size_t cell);
+
+        /**
+         * @brief Cell from moved to free cell to / cells a and b exchanged places
+         */
+        void move (order_index_t *idx, size_t from, size_t to);
+        void swap (order_index_t *idx, size_t a, size_t b);
+
+        /**
+         * @brief Range [first, last] in logical order is cut out / moved after cell after
+         */
+        void remove_range (order_index_t *idx, size_t first, size_t last);
+        void move_range   (order_index_t *idx, size_t first, size_t last, size_t after);
+
+        size_t kth  (const order_index_t *idx, size_t pos);
+        size_t rank (const order_index_t *idx, size_t cell);
+    }
+}
+
+#endif //ORDER_INDEX_H
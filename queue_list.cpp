@@ -0,0 +1,285 @@
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+
+#include "lib/log.h"
+#include "queue_list.h"
+
+// ----------------------------------------------------------------------------
+// STATIC DEFINITIONS
+// ----------------------------------------------------------------------------
+
+using list::to_index;
+
+static inline char *slot_data (const list::queue_t *queue, size_t pos);
+static inline std::atomic_ref<list::index_t> slot_mark (const list::queue_t *queue, size_t pos);
+
+static void copy_in  (list::queue_t *queue, size_t pos, const void *elems, size_t count);
+static void copy_out (const list::queue_t *queue, size_t pos, void *elems, size_t count);
+
+static size_t claim_spsc (list::queue_t *queue, size_t *pos, size_t count);
+static size_t claim_mpsc (list::queue_t *queue, size_t *pos, size_t count);
+static size_t ready_spsc (list::queue_t *queue, size_t pos, size_t max_count);
+static size_t ready_mpsc (const list::queue_t *queue, size_t pos, size_t max_count);
+
+// ----------------------------------------------------------------------------
+// PUBLIC FUNCTIONS
+// ----------------------------------------------------------------------------
+
+list::err_t list::queue::attach (queue_t *queue, list_t *list, queue_mode_t mode)
+{
+    assert (queue != nullptr && "pointer can't be nullptr");
+    assert (list  != nullptr && "pointer can't be nullptr");
+    list_assert (list);
+
+    if (list->capacity == 0)
+    {
+        log (log::ERR, "Queue needs list with reserved capacity");
+        return list::INVALID_CAPACITY;
+    }
+
+    // Elements go to cells 1..size, so they are slots 0..size-1 already
+    list::disable_order_index (list);
+    list::err_t res = list::sort (list);
+    if (res != list::OK)
+    {
+        return res;
+    }
+
+    queue->list  = list;
+    queue->mode  = mode;
+    queue->slots = list->capacity;
+
+    // Marks of the previous lap, no slot is ready
+    for (size_t i = 0; i < queue->slots; ++i)
+    {
+        list->next_arr[i + 1] = to_index (i + 1 - queue->slots);
+    }
+
+    for (size_t i = 0; i < list->size; ++i)
+    {
+        list->next_arr[i + 1] = to_index (i + 1);
+    }
+
+    queue->head.store (0, std::memory_order_relaxed);
+    queue->tail.store (list->size, std::memory_order_release);
+    queue->head_cache = 0;
+    queue->tail_cache = list->size;
+
+    return list::OK;
+}
+
+// ----------------------------------------------------------------------------
+
+void list::queue::detach (queue_t *queue)
+{
+    assert (queue       != nullptr && "pointer can't be nullptr");
+    assert (queue->list != nullptr && "queue is not attached");
+
+    list_t *list  = queue->list;
+    size_t  head  = queue->head.load (std::memory_order_acquire);
+    size_t  count = queue->tail.load (std::memory_order_acquire) - head;
+
+    // Oldest element goes to cell 1, ring wrap disappears
+    char *first = (char *) list->data_arr + list->obj_size;
+    std::rotate (first, first + (head % queue->slots) * list->obj_size,
+                 first + queue->slots * list->obj_size);
+
+    list->size = count;
+    list::relink_linear (list);
+
+    queue->list = nullptr;
+
+    list_assert (list);
+}
+
+// ----------------------------------------------------------------------------
+
+bool list::queue::push (queue_t *queue, const void *elem)
+{
+    return list::queue::push_n (queue, elem, 1) == 1;
+}
+
+size_t list::queue::push_n (queue_t *queue, const void *elems, size_t count)
+{
+    assert (queue       != nullptr && "pointer can't be nullptr");
+    assert (elems       != nullptr && "pointer can't be nullptr");
+    assert (queue->list != nullptr && "queue is not attached");
+
+    size_t pos = 0;
+
+    if (queue->mode == QUEUE_SPSC)
+    {
+        count = claim_spsc (queue, &pos, count);
+        copy_in (queue, pos, elems, count);
+
+        queue->tail.store (pos + count, std::memory_order_release);
+
+        return count;
+    }
+
+    count = claim_mpsc (queue, &pos, count);
+    copy_in (queue, pos, elems, count);
+
+    // Slots are published one by one: consumer stops at the first unready one
+    for (size_t i = 0; i < count; ++i)
+    {
+        slot_mark (queue, pos + i).store (to_index (pos + i + 1), std::memory_order_release);
+    }
+
+    return count;
+}
+
+// ----------------------------------------------------------------------------
+
+bool list::queue::pop (queue_t *queue, void *elem)
+{
+    return list::queue::pop_n (queue, elem, 1) == 1;
+}
+
+size_t list::queue::pop_n (queue_t *queue, void *elems, size_t max_count)
+{
+    assert (queue       != nullptr && "pointer can't be nullptr");
+    assert (elems       != nullptr && "pointer can't be nullptr");
+    assert (queue->list != nullptr && "queue is not attached");
+
+    size_t pos   = queue->head.load (std::memory_order_relaxed);
+    size_t count = (queue->mode == QUEUE_SPSC) ? ready_spsc (queue, pos, max_count) :
+                                                 ready_mpsc (queue, pos, max_count);
+
+    copy_out (queue, pos, elems, count);
+
+    // Frees the whole batch for producers
+    queue->head.store (pos + count, std::memory_order_release);
+
+    return count;
+}
+
+// ----------------------------------------------------------------------------
+
+size_t list::queue::size (const queue_t *queue)
+{
+    assert (queue != nullptr && "pointer can't be nullptr");
+
+    size_t head = queue->head.load (std::memory_order_acquire);
+    size_t tail = queue->tail.load (std::memory_order_acquire);
+
+    return (tail > head) ? tail - head : 0;
+}
+
+// ----------------------------------------------------------------------------
+// STATIC FUNCTIONS
+// ----------------------------------------------------------------------------
+
+// Slot pos % slots is cell 1 + pos % slots
+static inline char *slot_data (const list::queue_t *queue, size_t pos)
+{
+    return (char *) queue->list->data_arr + (1 + pos % queue->slots) * queue->list->obj_size;
+}
+
+// Mark == pos + 1 (truncated to index_t) means slot for pos is filled.
+// Capacity is below 2^(bits - 1), so mark of the previous lap never matches.
+static inline std::atomic_ref<list::index_t> slot_mark (const list::queue_t *queue, size_t pos)
+{
+    return std::atomic_ref<list::index_t> (queue->list->next_arr[1 + pos % queue->slots]);
+}
+
+// At most two memcpy: up to the ring end and from its start
+static void copy_in (list::queue_t *queue, size_t pos, const void *elems, size_t count)
+{
+    size_t obj_size = queue->list->obj_size;
+    size_t to_end   = queue->slots - pos % queue->slots;
+    size_t first    = (count < to_end) ? count : to_end;
+
+    memcpy (slot_data (queue, pos), elems, first * obj_size);
+
+    if (count > first)
+    {
+        memcpy (slot_data (queue, 0), (const char *) elems + first * obj_size,
+                (count - first) * obj_size);
+    }
+}
+
+static void copy_out (const list::queue_t *queue, size_t pos, void *elems, size_t count)
+{
+    size_t obj_size = queue->list->obj_size;
+    size_t to_end   = queue->slots - pos % queue->slots;
+    size_t first    = (count < to_end) ? count : to_end;
+
+    memcpy (elems, slot_data (queue, pos), first * obj_size);
+
+    if (count > first)
+    {
+        memcpy ((char *) elems + first * obj_size, slot_data (queue, 0),
+                (count - first) * obj_size);
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+// Wait-free: head is re-read only when cached value says there is no room
+static size_t claim_spsc (list::queue_t *queue, size_t *pos, size_t count)
+{
+    *pos = queue->tail.load (std::memory_order_relaxed);
+
+    size_t room = queue->slots - (*pos - queue->head_cache);
+    if (room < count)
+    {
+        queue->head_cache = queue->head.load (std::memory_order_acquire);
+        room = queue->slots - (*pos - queue->head_cache);
+    }
+
+    return (count < room) ? count : room;
+}
+
+// One CAS claims the whole batch, slots below head + slots are already consumed
+static size_t claim_mpsc (list::queue_t *queue, size_t *pos, size_t count)
+{
+    size_t tail = queue->tail.load (std::memory_order_relaxed);
+
+    while (true)
+    {
+        size_t head = queue->head.load (std::memory_order_acquire);
+        size_t room = queue->slots - (tail - head);
+        size_t take = (count < room) ? count : room;
+
+        if (take == 0)
+        {
+            *pos = tail;
+            return 0;
+        }
+
+        if (queue->tail.compare_exchange_weak (tail, tail + take, std::memory_order_relaxed))
+        {
+            *pos = tail;
+            return take;
+        }
+    }
+}
+
+static size_t ready_spsc (list::queue_t *queue, size_t pos, size_t max_count)
+{
+    size_t ready = queue->tail_cache - pos;
+    if (ready < max_count)
+    {
+        queue->tail_cache = queue->tail.load (std::memory_order_acquire);
+        ready = queue->tail_cache - pos;
+    }
+
+    return (max_count < ready) ? max_count : ready;
+}
+
+// Claimed slots may be filled out of order, batch ends at the first unfilled one
+static size_t ready_mpsc (const list::queue_t *queue, size_t pos, size_t max_count)
+{
+    size_t count = 0;
+
+    while (count < max_count &&
+           slot_mark (queue, pos + count).load (std::memory_order_acquire) ==
+           to_index (pos + count + 1))
+    {
+        count++;
+    }
+
+    return count;
+}
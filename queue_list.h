@@ -0,0 +1,86 @@
+#ifndef QUEUE_LIST_H
+#define QUEUE_LIST_H
+
+#include <atomic>
+#include <stddef.h>
+
+#include "list.h"
+
+// ----------------------------------------------------------------------------
+// FIFO mode over list storage. Cells 1..capacity of data_arr form a ring of
+// slots, next_arr is reused for per-slot ready marks of the MPSC mode.
+//  SPSC - wait-free, producer and consumer publish with one store per batch
+//  MPSC - lock-free, producers claim a batch of slots with one CAS,
+//         consumer is still single
+// While attached, the list must not be touched through list:: functions.
+// ----------------------------------------------------------------------------
+
+namespace list
+{
+    enum queue_mode_t
+    {
+        QUEUE_SPSC = 0,
+        QUEUE_MPSC = 1
+    };
+
+    // Producer and consumer fields live on separate cache lines
+    struct queue_t
+    {
+        list_t       *list  = nullptr;
+        queue_mode_t  mode  = QUEUE_SPSC;
+        size_t        slots = 0;
+
+        alignas (64) std::atomic<size_t> tail {0};
+        size_t                           head_cache = 0;    ///< producer's view of head (SPSC)
+
+        alignas (64) std::atomic<size_t> head {0};
+        size_t                           tail_cache = 0;    ///< consumer's view of tail (SPSC)
+    };
+
+    namespace queue
+    {
+        /**
+         * @brief Turns list into queue, current elements are queued in list order.
+         *        Capacity is fixed while attached, resize the list before.
+         */
+        err_t attach (queue_t *queue, list_t *list, queue_mode_t mode);
+
+        /**
+         * @brief Gives storage back to list with queued elements in FIFO order.
+         *        No producer or consumer may run during detach.
+         */
+        void detach (queue_t *queue);
+
+        /**
+         * @brief false if queue is full
+         */
+        bool push (queue_t *queue, const void *elem);
+
+        /**
+         * @brief Pushes up to count elements from contiguous array
+         *
+         * @return Number of pushed elements, less than count when queue fills up
+         */
+        size_t push_n (queue_t *queue, const void *elems, size_t count);
+
+        /**
+         * @brief false if queue is empty
+         */
+        bool pop (queue_t *queue, void *elem);
+
+        /**
+         * @brief Pops up to max_count elements into contiguous array, consumer
+         *        publishes the whole batch with one store
+         *
+         * @return Number of popped elements
+         */
+        size_t pop_n (queue_t *queue, void *elems, size_t max_count);
+
+        /**
+         * @brief Snapshot of queued elements count, exact only when quiescent
+         */
+        size_t size (const queue_t *queue);
+    }
+}
+
+#endif //QUEUE_LIST_H
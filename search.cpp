@@ -0,0 +1,297 @@
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined (__x86_64__) || defined (__i386__)
+    #include <immintrin.h>
+    #define LIST_SEARCH_X86 1
+#else
+    #define LIST_SEARCH_X86 0
+#endif
+
+#include "lib/log.h"
+#include "search.h"
+
+// ----------------------------------------------------------------------------
+// STATIC DEFINITIONS
+// ----------------------------------------------------------------------------
+
+// One mask bit per byte of a 32 byte block, masks are made in batches
+static const size_t BLOCK_BYTES = 32;
+static const size_t MASK_BATCH  = 64;
+
+typedef void (*mask_kernel_t)(const char *data, size_t blocks, const char *pattern, uint32_t *masks);
+
+#if LIST_SEARCH_X86
+__attribute__ ((target ("avx2")))
+static void masks_avx2  (const char *data, size_t blocks, const char *pattern, uint32_t *masks);
+static void masks_sse2  (const char *data, size_t blocks, const char *pattern, uint32_t *masks);
+#else
+static void masks_bytes (const char *data, size_t blocks, const char *pattern, uint32_t *masks);
+#endif
+
+static mask_kernel_t    mask_kernel ();
+static inline uint32_t lane_starts (uint32_t byte_mask, size_t obj_size);
+
+template <typename OnMatch>
+static void scan (const list::list_t *list, const void *elem, OnMatch on_match);
+
+// ----------------------------------------------------------------------------
+// PUBLIC FUNCTIONS
+// ----------------------------------------------------------------------------
+
+ssize_t list::find (const list_t *list, const void *elem)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+    assert (elem != nullptr && "pointer can't be nullptr");
+    list_assert (list);
+
+    ssize_t found = -1;
+
+    scan (list, elem, [&found] (size_t cell)
+    {
+        found = (ssize_t) cell;
+        return false;
+    });
+
+    return found;
+}
+
+// ----------------------------------------------------------------------------
+
+size_t list::count (const list_t *list, const void *elem)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+    assert (elem != nullptr && "pointer can't be nullptr");
+    list_assert (list);
+
+    size_t matches = 0;
+
+    scan (list, elem, [&matches] (size_t)
+    {
+        matches++;
+        return true;
+    });
+
+    return matches;
+}
+
+// ----------------------------------------------------------------------------
+
+size_t list::count_if (const list_t *list, bool (*pred)(const void *elem, void *ctx), void *ctx)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+    assert (pred != nullptr && "pointer can't be nullptr");
+    list_assert (list);
+
+    const char *data    = (const char *) list->data_arr;
+    size_t      matches = 0;
+
+    if (list->is_sorted)
+    {
+        size_t first = list->next_arr[0];
+        for (size_t cell = first; cell < first + list->size; ++cell)
+        {
+            matches += pred (data + cell * list->obj_size, ctx);
+        }
+
+        return matches;
+    }
+
+    for (size_t cell = 1; cell <= list->capacity; ++cell)
+    {
+        if ((list->prev_arr[cell] & list::FREE_FLAG) == 0)
+        {
+            matches += pred (data + cell * list->obj_size, ctx);
+        }
+    }
+
+    return matches;
+}
+
+// ----------------------------------------------------------------------------
+
+size_t list::find_all (const list_t *list, const void *elem, size_t *cells, size_t max_cells)
+{
+    assert (list != nullptr && "pointer can't be nullptr");
+    assert (elem != nullptr && "pointer can't be nullptr");
+    assert ((cells != nullptr || max_cells == 0) && "pointer can't be nullptr");
+    list_assert (list);
+
+    size_t matches = 0;
+
+    scan (list, elem, [&matches, cells, max_cells] (size_t cell)
+    {
+        if (matches < max_cells)
+        {
+            cells[matches] = cell;
+        }
+        matches++;
+        return true;
+    });
+
+    return matches;
+}
+
+// ----------------------------------------------------------------------------
+// STATIC FUNCTIONS
+// ----------------------------------------------------------------------------
+
+// Calls on_match (cell) for every live cell equal to elem until it returns false
+template <typename OnMatch>
+static void scan (const list::list_t *list, const void *elem, OnMatch on_match)
+{
+    size_t obj_size   = list->obj_size;
+    bool   check_free = !list->is_sorted;
+
+    // Sorted list keeps its live cells in one run starting at the head
+    size_t first   = check_free ? 1 : list->next_arr[0];
+    size_t n_cells = check_free ? list->capacity : list->size;
+
+    const char *data = (const char *) list->data_arr + first * obj_size;
+    size_t      done = 0;
+
+    bool vector_size = obj_size == 1 || obj_size == 2 || obj_size == 4 || obj_size == 8;
+
+    if (vector_size && n_cells * obj_size >= BLOCK_BYTES)
+    {
+        char pattern[BLOCK_BYTES] = {};
+        for (size_t i = 0; i < BLOCK_BYTES; ++i)
+        {
+            pattern[i] = ((const char *) elem)[i % obj_size];
+        }
+
+        static const mask_kernel_t kernel = mask_kernel ();
+
+        size_t   block_cells = BLOCK_BYTES / obj_size;
+        size_t   blocks      = n_cells / block_cells;
+        uint32_t masks[MASK_BATCH] = {};
+
+        for (size_t block = 0; block < blocks; block += MASK_BATCH)
+        {
+            size_t batch = (blocks - block < MASK_BATCH) ? blocks - block : MASK_BATCH;
+            kernel (data + block * BLOCK_BYTES, batch, pattern, masks);
+
+            for (size_t i = 0; i < batch; ++i)
+            {
+                for (uint32_t hits = lane_starts (masks[i], obj_size); hits != 0; hits &= hits - 1)
+                {
+                    size_t cell = first + (block + i) * block_cells +
+                                  (size_t) __builtin_ctz (hits) / obj_size;
+
+                    if (check_free && (list->prev_arr[cell] & list::FREE_FLAG) != 0)
+                    {
+                        continue;
+                    }
+
+                    if (!on_match (cell))
+                    {
+                        return;
+                    }
+                }
+            }
+        }
+
+        done = blocks * block_cells;
+    }
+
+    for (size_t i = done; i < n_cells; ++i)
+    {
+        size_t cell = first + i;
+
+        if (memcmp (data + i * obj_size, elem, obj_size) != 0 ||
+            (check_free && (list->prev_arr[cell] & list::FREE_FLAG) != 0))
+        {
+            continue;
+        }
+
+        if (!on_match (cell))
+        {
+            return;
+        }
+    }
+}
+
+// Element matches when all its bytes match, bit of its first byte is kept
+static inline uint32_t lane_starts (uint32_t byte_mask, size_t obj_size)
+{
+    switch (obj_size)
+    {
+        case 1:
+            return byte_mask;
+
+        case 2:
+            byte_mask &= byte_mask >> 1;
+            return byte_mask & 0x55555555u;
+
+        case 4:
+            byte_mask &= byte_mask >> 1;
+            byte_mask &= byte_mask >> 2;
+            return byte_mask & 0x11111111u;
+
+        case 8:
+            byte_mask &= byte_mask >> 1;
+            byte_mask &= byte_mask >> 2;
+            byte_mask &= byte_mask >> 4;
+            return byte_mask & 0x01010101u;
+
+        default:
+            assert (0 && "unsupported element size");
+            return 0;
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+static mask_kernel_t mask_kernel ()
+{
+#if LIST_SEARCH_X86
+    return __builtin_cpu_supports ("avx2") ? masks_avx2 : masks_sse2;
+#else
+    return masks_bytes;
+#endif
+}
+
+#if LIST_SEARCH_X86
+__attribute__ ((target ("avx2")))
+static void masks_avx2 (const char *data, size_t blocks, const char *pattern, uint32_t *masks)
+{
+    __m256i value = _mm256_loadu_si256 ((const __m256i *) pattern);
+
+    for (size_t i = 0; i < blocks; ++i)
+    {
+        __m256i block = _mm256_loadu_si256 ((const __m256i *) (data + i * BLOCK_BYTES));
+        masks[i] = (uint32_t) _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (block, value));
+    }
+}
+
+static void masks_sse2 (const char *data, size_t blocks, const char *pattern, uint32_t *masks)
+{
+    __m128i value = _mm_loadu_si128 ((const __m128i *) pattern);
+
+    for (size_t i = 0; i < blocks; ++i)
+    {
+        const char *block = data + i * BLOCK_BYTES;
+
+        __m128i low  = _mm_loadu_si128 ((const __m128i *) block);
+        __m128i high = _mm_loadu_si128 ((const __m128i *) (block + 16));
+
+        masks[i] = (uint32_t) _mm_movemask_epi8 (_mm_cmpeq_epi8 (low,  value)) |
+                   (uint32_t) _mm_movemask_epi8 (_mm_cmpeq_epi8 (high, value)) << 16;
+    }
+}
+#else
+// Portable build: same masks byte by byte
+static void masks_bytes (const char *data, size_t blocks, const char *pattern, uint32_t *masks)
+{
+    for (size_t i = 0; i < blocks; ++i)
+    {
+        uint32_t mask = 0;
+        for (size_t byte = 0; byte < BLOCK_BYTES; ++byte)
+        {
+            mask |= (uint32_t) (data[i * BLOCK_BYTES + byte] == pattern[byte]) << byte;
+        }
+        masks[i] = mask;
+    }
+}
+#endif
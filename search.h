@@ -0,0 +1,45 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "list.h"
+
+// ----------------------------------------------------------------------------
+// Search by value over data_arr without walking links. Elements of 1, 2, 4
+// or 8 bytes are compared 32 bytes at a time (AVX2 when the CPU has it,
+// SSE2 otherwise), other sizes fall back to memcmp per cell. Hits in free
+// cells are dropped by the free tag in prev_arr. A sorted list is one
+// contiguous sweep of its live cells.
+// Results are cell indexes in storage order, which is list order only for
+// a sorted list.
+// ----------------------------------------------------------------------------
+
+namespace list
+{
+    /**
+     * @brief First cell (in storage order) equal to elem byte-wise, -1 if none
+     */
+    ssize_t find (const list_t *list, const void *elem);
+
+    /**
+     * @brief Number of elements equal to elem byte-wise
+     */
+    size_t count (const list_t *list, const void *elem);
+
+    /**
+     * @brief Number of elements for which pred returns true, cells are scanned
+     *        in storage order
+     */
+    size_t count_if (const list_t *list, bool (*pred)(const void *elem, void *ctx), void *ctx);
+
+    /**
+     * @brief Writes up to max_cells matching cells to cells
+     *
+     * @return Total number of matches, may be more than max_cells
+     */
+    size_t find_all (const list_t *list, const void *elem, size_t *cells, size_t max_cells);
+}
+
+#endif //SEARCH_H
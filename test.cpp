@@ -1,5 +1,16 @@
 #include <stdio.h>
+#include <algorithm>
+#include <iterator>
+#include <thread>
+#include <vector>
 #include "list.h"
+#include "typed_list.h"
+#include "allocator.h"
+#include "mapped_list.h"
+#include "concurrent_list.h"
+#include "queue_list.h"
+#include "list_iterator.h"
+#include "search.h"
 #include "test.h"
 #include "lib/log.h"
 
@@ -195,10 +206,1807 @@ int test_sorted_with_shift ()
     val = 0; list::pop_front (&list, &val);
     val = 4; list::push_back (&list, &val);
 
+    // Cell after the tail was free, run just moved by one
+    _ASSERT (list.is_sorted == true);
+
+    // Tail is the last cell, only the freed front cell is left
+    val = 5; list::push_back (&list, &val);
+
+    _ASSERT (list.is_sorted == false);
+
+    TEST_END ();
+}
+
+int test_order_index ()
+{
+    TEST_START ();
+
+    _ASSERT (list::enable_order_index (&list) == list::OK);
+
+    for (int i = 0; i < 64; ++i)
+    {
+        val = i;
+        if (i % 2) list::push_back  (&list, &val);
+        else       list::push_front (&list, &val);
+    }
+
+    val = 100; list::insert_after (&list, list::get_iter (&list, 10), &val);
+    val = 0;   list::remove       (&list, list::get_iter (&list, 40), &val);
+
+    _ASSERT (list.is_sorted == false);
+
+    size_t iter = list::head (&list);
+    for (size_t i = 0; i < list.size; ++i)
+    {
+        _ASSERT (list::get_iter (&list, i) == iter);
+        iter = list::next (&list, iter);
+    }
+
+    list::get (&list, list::get_iter (&list, 11), &val);
+    _ASSERT (val == 100);
+
+    list::sort (&list);
+    list.is_sorted = false;
+    _ASSERT (list::get_iter (&list, 11) == 12);
+
+    TEST_END ();
+}
+
+int test_compact_step ()
+{
+    TEST_START ();
+
+    for (int i = 0; i < 32; ++i)
+    {
+        val = i;
+        if (i % 2) list::push_back  (&list, &val);
+        else       list::push_front (&list, &val);
+    }
+
+    val = 0; list::remove (&list, list::head (&list), &val);
+    val = 0; list::remove (&list, list::next (&list, list::head (&list)), &val);
+
+    _ASSERT (list.is_sorted == false);
+
+    size_t steps = 0;
+    while (!list::compact_step (&list, 4))
+    {
+        _ASSERT (list::verify (&list) == list::OK);
+        steps++;
+    }
+
+    _ASSERT (steps > 1);
+    _ASSERT (list::head (&list) == 1);
+
+    for (size_t i = 0; i < list.size; ++i)
+    {
+        _ASSERT (list::get_iter (&list, i) == i + 1);
+    }
+
+    list::get (&list, list::head (&list), &val);
+    _ASSERT (val == 28);
+    list::get (&list, list::tail (&list), &val);
+    _ASSERT (val == 31);
+
+    TEST_END ();
+}
+
+int test_compact_budget ()
+{
+    TEST_START ();
+
+    _ASSERT (list::enable_order_index (&list) == list::OK);
+    list::set_compact_budget (&list, 2);
+
+    for (int i = 0; i < 32; ++i)
+    {
+        val = i;
+        ssize_t index = (i % 2) ? list::push_back  (&list, &val) :
+                                  list::push_front (&list, &val);
+
+        val = -1;
+        list::get (&list, (size_t) index, &val);
+        _ASSERT (val == i);
+    }
+
+    for (int i = 0; i < 32 && !list.is_sorted; ++i)
+    {
+        val = 0; list::push_back (&list, &val);
+        val = 0; list::pop_back  (&list, &val);
+    }
+
+    _ASSERT (list.is_sorted == true);
+    _ASSERT (list::verify (&list) == list::OK);
+
+    list.is_sorted = false;
+    list::get (&list, list::get_iter (&list, 0), &val);
+    _ASSERT (val == 30);
+    list::get (&list, list::get_iter (&list, 16), &val);
+    _ASSERT (val == 1);
+    list.is_sorted = true;
+
+    TEST_END ();
+}
+
+int test_sort_in_place ()
+{
+    TEST_START ();
+
+    for (int i = 0; i < 20; ++i)
+    {
+        val = i;
+        if (i % 3) list::push_back  (&list, &val);
+        else       list::push_front (&list, &val);
+    }
+
+    val = 0; list::remove (&list, list::get_iter (&list, 5), &val);
+    _ASSERT (val == 3);
+
+    _ASSERT (list::resize (&list, 64, true) == list::OK);
+    _ASSERT (list::verify (&list) == list::OK);
+    _ASSERT (list.is_sorted == true);
+    _ASSERT (list::head (&list) == 1);
+
+    list::get (&list, list::get_iter (&list, 0),  &val);
+    _ASSERT (val == 18);
+    list::get (&list, list::get_iter (&list, 5),  &val);
+    _ASSERT (val == 0);
+    list::get (&list, list::get_iter (&list, 18), &val);
+    _ASSERT (val == 19);
+
+    TEST_END ();
+}
+
+int test_capacity_overflow ()
+{
+    TEST_START ();
+
+    _ASSERT (list::resize (&list, list::MAX_CAPACITY + 1) == list::CAPACITY_OVERFLOW);
+    _ASSERT (list::verify (&list) == list::OK);
+
+    val = 1;
+    _ASSERT (list::push_back (&list, &val) > 0);
+
+    TEST_END ();
+}
+
+int test_verify_local ()
+{
+    TEST_START ();
+
+    val = 1; list::push_back (&list, &val);
+    val = 2; size_t index = (size_t) list::push_back (&list, &val);
+    val = 3; list::push_back (&list, &val);
+
+    _ASSERT (list::verify_local (&list, index) == list::OK);
+
+    list::index_t saved = list.next_arr[index];
+    list.next_arr[index] = 1;
+
+    _ASSERT (list::verify_local (&list, index) == list::BROKEN_DATA_LOOP);
+    _ASSERT (list::verify_local (&list, 0)     == list::OK);
+
+    list.next_arr[index] = saved;
+
+    TEST_END ();
+}
+
+int test_push_back_n ()
+{
+    TEST_START ();
+
+    int vals[100] = {};
+    for (int i = 0; i < 100; ++i)
+    {
+        vals[i] = i;
+    }
+
+    _ASSERT (list::push_back_n (&list, vals, 60) == 1);
+    _ASSERT (list::push_back_n (&list, vals + 60, 40) == 61);
+    _ASSERT (list.is_sorted == true);
+    _ASSERT (list.size == 100);
+
+    list::get (&list, list::get_iter (&list, 99), &val);
+    _ASSERT (val == 99);
+
+    val = 0; list::pop_front (&list, &val);
+    val = 0; list::pop_front (&list, &val);
+
+    ssize_t first = list::insert_range_after (&list, list::get_iter (&list, 10), vals, 3);
+    _ASSERT (first > 0);
+    _ASSERT (list.is_sorted == false);
+    _ASSERT (list::verify (&list) == list::OK);
+
+    list::get (&list, list::next (&list, (size_t) first), &val);
+    _ASSERT (val == 1);
+
+    size_t iter = list::head (&list);
+    for (int i = 0; i < 14; ++i)
+    {
+        iter = list::next (&list, iter);
+    }
+    list::get (&list, iter, &val);
+    _ASSERT (val == 13);
+
+    TEST_END ();
+}
+
+// ----------------------------------------------------------------------------
+
+int test_splice_same_list ()
+{
+    TEST_START ();
+
+    int vals[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+    list::push_back_n (&list, vals, 10);
+    list::enable_order_index (&list);
+
+    // [2, 4] goes after 7: 0 1 5 6 7 2 3 4 8 9
+    _ASSERT (list::splice (&list, 8, &list, 3, 5) == list::OK);
+    _ASSERT (list::verify (&list) == list::OK);
+    _ASSERT (list.is_sorted == false);
+
+    int expected[10] = {0, 1, 5, 6, 7, 2, 3, 4, 8, 9};
+    for (int i = 0; i < 10; ++i)
+    {
+        list::get (&list, list::get_iter (&list, (size_t) i), &val);
+        _ASSERT (val == expected[i]);
+    }
+
+    TEST_END ();
+}
+
+int test_splice_concat ()
+{
+    TEST_START ();
+
+    list::list_t other;
+    list::ctor (&other, sizeof (int), 0, print_int);
+
+    int vals[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+    list::push_back_n (&list,  vals,     5);
+    list::push_back_n (&other, vals + 5, 5);
+    list::pop_front (&other, &val);
+    list::push_back (&other, &val);
+
+    _ASSERT (list::concat (&list, &other) == list::OK);
+    _ASSERT (list::verify (&list)  == list::OK);
+    _ASSERT (list::verify (&other) == list::OK);
+    _ASSERT (list.size == 10 && other.size == 0);
+
+    _ASSERT (list::split_after (&list, list::get_iter (&list, 6), &other) == list::OK);
+    _ASSERT (list::verify (&list)  == list::OK);
+    _ASSERT (list::verify (&other) == list::OK);
+    _ASSERT (list.size == 7 && other.size == 3);
+
+    int expected[10] = {0, 1, 2, 3, 4, 6, 7, 8, 9, 5};
+    size_t iter = list::head (&list);
+    for (int i = 0; i < 7; ++i, iter = list::next (&list, iter))
+    {
+        list::get (&list, iter, &val);
+        _ASSERT (val == expected[i]);
+    }
+
+    iter = list::head (&other);
+    for (int i = 7; i < 10; ++i, iter = list::next (&other, iter))
+    {
+        list::get (&other, iter, &val);
+        _ASSERT (val == expected[i]);
+    }
+
+    list::dtor (&other);
+
+    TEST_END ();
+}
+
+int test_shrink_to_fit ()
+{
+    TEST_START ();
+
+    for (int i = 0; i < 100; ++i)
+    {
+        list::push_back (&list, &i);
+    }
+
+    for (int i = 0; i < 90; ++i)
+    {
+        list::remove (&list, list::get_iter (&list, 5), &val);
+    }
+
+    _ASSERT (list::resize (&list, 5) == list::INVALID_CAPACITY);
+    _ASSERT (list::shrink_to_fit (&list) == list::OK);
+    _ASSERT (list::verify (&list) == list::OK);
+    _ASSERT (list.capacity == 10);
+    _ASSERT (list.free_head == 0);
+
+    int expected[10] = {0, 1, 2, 3, 4, 95, 96, 97, 98, 99};
+    for (int i = 0; i < 10; ++i)
+    {
+        list::get (&list, list::get_iter (&list, (size_t) i), &val);
+        _ASSERT (val == expected[i]);
+    }
+
+    list::push_back (&list, &val);
+    _ASSERT (list::verify (&list) == list::OK);
+    _ASSERT (list.capacity == 20);
+
+    TEST_END ();
+}
+
+int test_shrink_free_chain ()
+{
+    TEST_START ();
+
+    // Storage stays linear after pops, but the free chain is LIFO
+    for (val = 0; val < 16; ++val)
+    {
+        list::push_back (&list, &val);
+    }
+    for (int i = 0; i < 16; ++i)
+    {
+        list::pop_front (&list, &val);
+    }
+
+    _ASSERT (list::resize (&list, 4) == list::OK);
+    _ASSERT (list.capacity == 4);
+    _ASSERT (list::verify (&list) == list::OK);
+
+    list::dtor (&list);
+    list::ctor (&list, sizeof (int), 0, print_int);
+
+    // Compaction linearises storage without touching the free chain
+    for (val = 0; val < 9; ++val)
+    {
+        list::push_back (&list, &val);
+    }
+    list::remove   (&list, 2, &val);
+    list::remove   (&list, 5, &val);
+    list::pop_back (&list, &val);
+
+    while (!list::compact_step (&list, 1)) {}
+
+    _ASSERT (list::resize (&list, 8) == list::OK);
+    _ASSERT (list::verify (&list) == list::OK);
+
+    // Reserved capacity is a floor for shrinking
+    list::list_t reserved;
+    list::ctor (&reserved, sizeof (int), 16, print_int);
+    list::push_back (&reserved, &val);
+
+    list::err_t below_reserved = list::resize (&reserved, 8);
+    list::err_t fit            = list::shrink_to_fit (&reserved);
+    size_t      fit_capacity   = reserved.capacity;
+    list::err_flags flags      = list::verify (&reserved);
+
+    list::dtor (&reserved);
+
+    _ASSERT (below_reserved == list::INVALID_CAPACITY);
+    _ASSERT (fit == list::OK && fit_capacity == 16);
+    _ASSERT (flags == list::OK);
+
+    TEST_END ();
+}
+
+int test_auto_shrink ()
+{
+    TEST_START ();
+
+    list::set_auto_shrink (&list, true);
+
+    for (int i = 0; i < 64; ++i)
+    {
+        list::push_back (&list, &i);
+    }
+    _ASSERT (list.capacity == 64);
+
+    for (int i = 0; i < 48; ++i)
+    {
+        list::pop_front (&list, &val);
+    }
+    _ASSERT (list.capacity == 32);
+    _ASSERT (list::verify (&list) == list::OK);
+
+    // Hysteresis: half full list doesn't flip back and forth
+    list::push_back (&list, &val);
+    list::pop_back  (&list, &val);
+    _ASSERT (list.capacity == 32);
+
+    list::get (&list, list::head (&list), &val);
+    _ASSERT (val == 48);
+
+    TEST_END ();
+}
+
+int test_arena_allocator ()
+{
+    list::arena_t arena = {};
+    if (!list::arena_ctor (&arena, 64 * 1024))
+    {
+        return -1;
+    }
+
+    list::allocator_t alloc = list::arena_allocator (&arena);
+
+    list::list_t list;
+    _ASSERT (list::ctor (&list, sizeof (int), 0, print_int, &alloc) == list::OK);
+
+    for (int i = 0; i < 100; ++i)
+    {
+        _ASSERT (list::push_back (&list, &i) > 0);
+    }
+    _ASSERT (list::verify (&list) == list::OK);
+
+    // Arrays live in the arena
+    _ASSERT ((char *) list.data_arr >= arena.buf && (char *) list.data_arr < arena.buf + arena.capacity);
+
+    int val = 0;
+    list::get (&list, list::get_iter (&list, 99), &val);
+    _ASSERT (val == 99);
+
+    // Exhausted arena is reported as OOM
+    _ASSERT (list::resize (&list, 16000) == list::OOM);
+    _ASSERT (list::verify (&list) == list::OK);
+
+    list::dtor (&list);
+    list::arena_dtor (&arena);
+
+    return 0;
+}
+
+int test_mmap_allocator ()
+{
+    list::allocator_t alloc = list::mmap_allocator ();
+
+    list::list_t list;
+    _ASSERT (list::ctor (&list, sizeof (int), 0, print_int, &alloc) == list::OK);
+
+    for (int i = 0; i < 5000; ++i)
+    {
+        _ASSERT (list::push_back (&list, &i) > 0);
+    }
+    for (int i = 0; i < 4000; ++i)
+    {
+        int val = 0;
+        list::pop_front (&list, &val);
+    }
+    _ASSERT (list::shrink_to_fit (&list) == list::OK);
+    _ASSERT (list::verify (&list) == list::OK);
+
+    int val = 0;
+    list::get (&list, list::head (&list), &val);
+    _ASSERT (val == 4000);
+
+    list::dtor (&list);
+
+    return 0;
+}
+
+// Heap allocator that refuses to grow blocks after reallocs_left successful
+// growths and counts allocations and bytes by the sizes the list passes in
+struct limited_heap_t
+{
+    size_t reallocs_left;
+    size_t bytes;
+    size_t allocs;
+};
+
+static void *limited_alloc (void *ctx, size_t size)
+{
+    ((limited_heap_t *) ctx)->bytes += size;
+    ((limited_heap_t *) ctx)->allocs++;
+    return malloc (size);
+}
+
+static void *limited_realloc (void *ctx, void *ptr, size_t old_size, size_t new_size)
+{
+    limited_heap_t *heap = (limited_heap_t *) ctx;
+    if (new_size > old_size)
+    {
+        if (heap->reallocs_left == 0)
+        {
+            return nullptr;
+        }
+
+        heap->reallocs_left--;
+    }
+
+    void *res = realloc (ptr, new_size);
+    if (res != nullptr)
+    {
+        heap->bytes += new_size - old_size;
+    }
+
+    return res;
+}
+
+static void limited_free (void *ctx, void *ptr, size_t size)
+{
+    ((limited_heap_t *) ctx)->bytes -= size;
+    free (ptr);
+}
+
+int test_append_fallback ()
+{
+    limited_heap_t    heap  = {SIZE_MAX, 0, 0};
+    list::allocator_t alloc = {&heap, limited_alloc, limited_realloc, limited_free};
+
+    list::list_t list;
+    _ASSERT (list::ctor (&list, sizeof (int), 32, print_int, &alloc) == list::OK);
+
+    int vals[32] = {};
+    for (int i = 0; i < 32; ++i)
+    {
+        vals[i] = i;
+    }
+
+    _ASSERT (list::push_back_n (&list, vals, 32) > 0);
+    _ASSERT (list.capacity == 32);
+
+    int val = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        list::pop_front (&list, &val);
+    }
+    _ASSERT (list.is_sorted == true);
+
+    // Tail is the last cell, appending after it in place would need to grow
+    heap.reallocs_left = 0;
+    _ASSERT (list::push_back_n (&list, vals, 8) > 0);
+    _ASSERT (list.capacity == 32);
+    _ASSERT (list.size == 24);
+    _ASSERT (list::verify (&list) == list::OK);
+
+    size_t iter = list::head (&list);
+    for (int i = 0; i < 24; ++i, iter = list::next (&list, iter))
+    {
+        list::get (&list, iter, &val);
+        _ASSERT (val == (i < 16 ? i + 16 : i - 16));
+    }
+
+    list::dtor (&list);
+
+    return 0;
+}
+
+int test_splice_oom ()
+{
+    TEST_START ();
+
+    limited_heap_t    heap  = {0, 0, 0};
+    list::allocator_t alloc = {&heap, limited_alloc, limited_realloc, limited_free};
+
+    list::list_t dst;
+    _ASSERT (list::ctor (&dst, sizeof (int), 8, print_int, &alloc) == list::OK);
+
+    for (int i = 0; i < 20; ++i)
+    {
+        list::push_back (&list, &i);
+    }
+
+    // dst can't grow: splice fails and src keeps its elements
+    _ASSERT (list::splice (&dst, 0, &list, list::head (&list), list::tail (&list)) == list::OOM);
+    _ASSERT (list.size == 20);
+    _ASSERT (dst.size  == 0);
+    _ASSERT (list::verify (&list) == list::OK);
+    _ASSERT (list::verify (&dst)  == list::OK);
+
+    // Tail of dst is its last cell, the range still fits into its free cells
+    for (int i = 0; i < 8; ++i)
+    {
+        list::push_back (&dst, &i);
+    }
+    for (int i = 0; i < 4; ++i)
+    {
+        list::pop_front (&dst, &val);
+    }
+
+    _ASSERT (list::splice (&dst, list::tail (&dst), &list, list::head (&list), list::get_iter (&list, 3)) == list::OK);
+    _ASSERT (list.size == 16);
+    _ASSERT (dst.size  == 8);
+    _ASSERT (dst.capacity == 8);
+    _ASSERT (list::verify (&dst) == list::OK);
+
+    list::get (&dst, list::tail (&dst), &val);
+    _ASSERT (val == 3);
+
+    list::dtor (&dst);
+
+    TEST_END ();
+}
+
+int test_resize_rollback ()
+{
+    limited_heap_t    heap  = {1, 0, 0};
+    list::allocator_t alloc = {&heap, limited_alloc, limited_realloc, limited_free};
+
+    list::list_t list;
+    _ASSERT (list::ctor (&list, sizeof (int), 16, print_int, &alloc) == list::OK);
+
+    for (int i = 0; i < 16; ++i)
+    {
+        list::push_back (&list, &i);
+    }
+
+    // Data array grows, next array fails: data array is shrunk back
+    _ASSERT (list::resize (&list, 64) == list::OOM);
+    _ASSERT (list.capacity == 16);
+    _ASSERT (list::verify (&list) == list::OK);
+
+    heap.reallocs_left = SIZE_MAX;
+    _ASSERT (list::resize (&list, 64) == list::OK);
+    _ASSERT (list::verify (&list) == list::OK);
+
+    int val = 0;
+    list::get (&list, list::tail (&list), &val);
+    _ASSERT (val == 15);
+
+    list::dtor (&list);
+
+    // Every array is freed with the size it was allocated with
+    return (heap.bytes == 0) ? 0 : -1;
+}
+
+static uint64_t int_key (const void *elem)
+{
+    return (uint64_t) *(const int *) elem;
+}
+
+int test_allocator_owns_all ()
+{
+    limited_heap_t    heap  = {SIZE_MAX, 0, 0};
+    list::allocator_t alloc = {&heap, limited_alloc, limited_realloc, limited_free};
+
+    list::list_t list;
+    _ASSERT (list::ctor (&list, sizeof (int), 0, print_int, &alloc) == list::OK);
+
+    for (int i = 0; i < 20000; ++i)
+    {
+        list::push_front (&list, &i);
+    }
+
+    // Index struct and its five arrays
+    size_t allocs = heap.allocs;
+    _ASSERT (list::enable_order_index (&list) == list::OK);
+    _ASSERT (heap.allocs == allocs + 6);
+
+    // Histograms and keys
+    allocs = heap.allocs;
+    _ASSERT (list::sort_by_key (&list, int_key) == list::OK);
+    _ASSERT (heap.allocs == allocs + 2);
+
+    int val = 0;
+    list::get (&list, list::get_iter (&list, 0), &val);
+    _ASSERT (val == 0);
+
+    // Rulers and new data array
+    allocs = heap.allocs;
+    _ASSERT (list::sort_parallel (&list, 2) == list::OK);
+    _ASSERT (heap.allocs == allocs + 2);
+    _ASSERT (list::verify (&list) == list::OK);
+
+    list::dtor (&list);
+
+    return (heap.bytes == 0) ? 0 : -1;
+}
+
+int test_mapped_roundtrip ()
+{
+    TEST_START ();
+
+    const char *path = "/tmp/list_test_mapped.lst";
+
+    for (int i = 0; i < 50; ++i)
+    {
+        list::push_front (&list, &i);
+    }
+    list::remove (&list, list::get_iter (&list, 10), &val);
+
+    _ASSERT (list::mapped::save (&list, path) == list::OK);
+
+    list::list_t mapped;
+    _ASSERT (list::mapped::open (&mapped, path, sizeof (int), true, print_int) == list::OK);
+    _ASSERT (list::verify (&mapped) == list::OK);
+    _ASSERT (mapped.size == 49 && mapped.is_sorted == false);
+
+    for (size_t iter = list::head (&list), m_iter = list::head (&mapped); iter != 0;
+         iter = list::next (&list, iter), m_iter = list::next (&mapped, m_iter))
+    {
+        int m_val = 0;
+        list::get (&list,   iter,   &val);
+        list::get (&mapped, m_iter, &m_val);
+        _ASSERT (val == m_val);
+    }
+
+    // Shared mapping keeps in-place mutations
+    list::pop_front (&mapped, &val);
+    list::mapped::close (&mapped);
+
+    _ASSERT (list::mapped::open (&mapped, path, sizeof (int), false, print_int) == list::OK);
+    _ASSERT (mapped.size == 48);
+    list::get (&mapped, list::head (&mapped), &val);
+    _ASSERT (val == 48);
+
+    // Growth moves private mapping to heap
+    for (int i = 0; i < 100; ++i)
+    {
+        list::push_back (&mapped, &i);
+    }
+    _ASSERT (list::verify (&mapped) == list::OK);
+    list::mapped::close (&mapped);
+
+    // Shared mapping doesn't grow past the file, edits made before the failed growth persist
+    _ASSERT (list::mapped::open (&mapped, path, sizeof (int), true, print_int) == list::OK);
+    size_t file_capacity = mapped.capacity;
+
+    list::remove (&mapped, list::get_iter (&mapped, 5), &val);
+    for (int i = 0; list::push_back (&mapped, &i) > 0; ++i)
+    {
+        _ASSERT (mapped.size <= file_capacity);
+    }
+    _ASSERT (mapped.size == file_capacity);
+    _ASSERT (mapped.capacity == file_capacity);
+
+    // Copying sort moves data out of the file, close writes it back
+    _ASSERT (list::sort (&mapped, true) == list::OK);
+    list::mapped::close (&mapped);
+
+    _ASSERT (list::mapped::open (&mapped, path, sizeof (int), false, print_int) == list::OK);
+    _ASSERT (list::verify (&mapped) == list::OK);
+    _ASSERT (mapped.size == file_capacity);
+
+    list::get (&mapped, list::get_iter (&mapped, 5), &val);
+    _ASSERT (val == 42);
+    list::get (&mapped, list::tail (&mapped), &val);
+    _ASSERT (val == (int) (file_capacity - 48));
+    list::mapped::close (&mapped);
+
+    _ASSERT (list::mapped::open (&mapped, path, sizeof (double), false, print_int) == list::BAD_FORMAT);
+
+    remove (path);
+
+    TEST_END ();
+}
+
+int test_save_load ()
+{
+    TEST_START ();
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        list::push_front (&list, &i);
+    }
+    list::remove (&list, list::get_iter (&list, 500), &val);
+
+    for (int raw = 0; raw < 2; ++raw)
+    {
+        FILE *stream = tmpfile ();
+        _ASSERT (stream != nullptr);
+        _ASSERT (list::save (&list, stream, raw) == list::OK);
+
+        rewind (stream);
+
+        list::list_t loaded;
+        _ASSERT (list::load (&loaded, stream, sizeof (int), print_int) == list::OK);
+        _ASSERT (loaded.size == list.size);
+        _ASSERT (loaded.is_sorted == !raw);
+
+        for (size_t iter = list::head (&list), l_iter = list::head (&loaded); iter != 0;
+             iter = list::next (&list, iter), l_iter = list::next (&loaded, l_iter))
+        {
+            int l_val = 0;
+            list::get (&list,   iter,   &val);
+            list::get (&loaded, l_iter, &l_val);
+            _ASSERT (val == l_val);
+        }
+
+        list::dtor (&loaded);
+
+        // Flipped payload byte is caught by block checksum
+        fseek (stream, (long) sizeof (int) * 100, SEEK_SET);
+        int byte = fgetc (stream);
+        fseek (stream, (long) sizeof (int) * 100, SEEK_SET);
+        fputc (byte ^ 1, stream);
+        rewind (stream);
+
+        _ASSERT (list::load (&loaded, stream, sizeof (int), print_int) == list::BAD_FORMAT);
+
+        // Flipped top byte of header capacity is caught by header checksum
+        const long capacity_top = 8 + 4 + 4 + 8 + 7;
+        fseek (stream, capacity_top, SEEK_SET);
+        fputc (0x7f, stream);
+        rewind (stream);
+
+        _ASSERT (list::load (&loaded, stream, sizeof (int), print_int) == list::BAD_FORMAT);
+
+        fclose (stream);
+    }
+
+    // Raw snapshot claims sorted storage with a hole in the run
+    list::remove (&list, list::get_iter (&list, 100), &val);
+    list.is_sorted = true;
+
+    FILE *stream = tmpfile ();
+    _ASSERT (stream != nullptr);
+    _ASSERT (list::save (&list, stream, true) == list::OK);
+    list.is_sorted = false;
+    rewind (stream);
+
+    list::list_t loaded;
+    _ASSERT (list::load (&loaded, stream, sizeof (int), print_int) == list::OK);
+    fclose (stream);
+
+    _ASSERT (loaded.is_sorted == false);
+    list::get (&list,   list::tail (&list), &val);
+    int l_val = 0;
+    list::get (&loaded, list::get_iter (&loaded, loaded.size - 1), &l_val);
+    _ASSERT (val == l_val);
+
+    // Saved capacity is not a reserve: loaded list shrinks
+    _ASSERT (list::shrink_to_fit (&loaded) == list::OK);
+    _ASSERT (loaded.capacity == loaded.size);
+    _ASSERT (list::verify (&loaded) == list::OK);
+
+    list::dtor (&loaded);
+
+    TEST_END ();
+}
+
+int test_stats ()
+{
+    TEST_START ();
+
+    for (int i = 0; i < 16; ++i)
+    {
+        list::push_front (&list, &i);
+    }
+    list::pop_back (&list, &val);
+
+    list::stats_t stats = list::stats (&list);
+    _ASSERT (stats.live_bytes     == 15 * (sizeof (int) + 2 * sizeof (list::index_t)));
+    _ASSERT (stats.capacity_bytes == 17 * (sizeof (int) + 2 * sizeof (list::index_t)));
+    _ASSERT (stats.locality < 0.01);
+
+    list::sort (&list);
+    stats = list::stats (&list);
+    _ASSERT (stats.locality > 0.99);
+    _ASSERT (stats.free_fragmentation < 0.01);
+
+#if LIST_STATS
+    _ASSERT (stats.ops.inserts    == 16);
+    _ASSERT (stats.ops.removes    == 1);
+    _ASSERT (stats.ops.resizes    == 5);
+    _ASSERT (stats.ops.linearises == 1);
+
+    list::push_front (&list, &val);
+    list::get_iter (&list, 10);
+    stats = list::stats (&list);
+    _ASSERT (stats.ops.get_iters     == 1);
+    _ASSERT (stats.ops.get_iter_hops == 10);
+
+    list::reset_stats (&list);
+    _ASSERT (list::stats (&list).ops.inserts == 0);
+#endif
+
+    TEST_END ();
+}
+
+int test_async_log ()
+{
+    TEST_START ();
+
+    FILE *main_stream = get_log_stream ();
+    FILE *stream      = tmpfile ();
+    _ASSERT (stream != nullptr);
+
+    char name[] = "list";
+
+    set_log_stream (stream);
+    set_log_async (true);
+
+    for (int i = 0; i < 2000; ++i)
+    {
+        log (log::ERR, "async %d %s %zu %.2f %5x%%", i, name, (size_t) i * 2, 0.5, 255u);
+    }
+    name[0] = 'X';
+
+    // Strings past the per-record buffer are cut, neighbours stay intact
+    std::vector<char> long_str (5000, 'b');
+    std::vector<char> mid_str  (300,  'a');
+    long_str.back () = '\0';
+    mid_str.back ()  = '\0';
+    log (log::ERR, "long [%s] [%s] [%s]", mid_str.data (), long_str.data (), name);
+
+    set_log_async (false);
+    set_log_stream (main_stream);
+
+    rewind (stream);
+
+    char   line[256] = "";
+    size_t count     = 0;
+    while (fgets (line, sizeof (line), stream) != nullptr)
+    {
+        char expected[64] = "";
+        snprintf (expected, sizeof (expected), "async %zu list %zu 0.50    ff%%\n", count, count * 2);
+
+        if (strstr (line, "async") != nullptr)
+        {
+            _ASSERT (strstr (line, expected) != nullptr);
+            count++;
+        }
+    }
+    _ASSERT (count == 2000);
+
+    // Record with cut strings didn't spill into the ones around it
+    rewind (stream);
+
+    std::vector<char> long_line (8192);
+    bool cut = false;
+    while (fgets (long_line.data (), (int) long_line.size (), stream) != nullptr)
+    {
+        if (strstr (long_line.data (), "long [") != nullptr)
+        {
+            cut = strstr (long_line.data (), "a] [] []") != nullptr &&
+                  strstr (long_line.data (), "bb") == nullptr;
+        }
+    }
+    _ASSERT (cut);
+
+    fclose (stream);
+
+    TEST_END ();
+}
+
+// ----------------------------------------------------------------------------
+
+int test_iterators ()
+{
+    TEST_START ();
+
+    for (val = 0; val < 10; ++val)
+    {
+        list::push_front (&list, &val);
+    }
+
+    int sum = 0;
+    for (int elem : list::view<int> (&list))
+    {
+        sum += elem;
+    }
+    _ASSERT (sum == 45);
+
+    auto elems = list::view<int> (&list);
+    _ASSERT (*elems.begin () == 9);
+    _ASSERT (*std::prev (elems.end ()) == 0);
+    _ASSERT (std::distance (elems.begin (), elems.end ()) == 10);
+
+    auto found = std::find (elems.begin (), elems.end (), 4);
+    _ASSERT (found != elems.end () && *found == 4);
+
+    // Writes go through to cells, order is logical even for unsorted storage
+    for (int &elem : elems)
+    {
+        elem *= 2;
+    }
+    _ASSERT (std::is_sorted (std::make_reverse_iterator (elems.end ()),
+                             std::make_reverse_iterator (elems.begin ())));
+    _ASSERT (std::count_if (elems.begin (), elems.end (), [] (int x) { return x > 10; }) == 4);
+
+    list::typed_list<int, uint16_t> typed;
+    list::ctor (&typed, 0);
+    for (int i = 1; i <= 5; ++i)
+    {
+        list::push_back (&typed, i);
+    }
+
+    int product = 1;
+    for (int elem : typed)
+    {
+        product *= elem;
+    }
+
+    const list::typed_list<int, uint16_t> *const_typed = &typed;
+    auto typed_elems = list::view (const_typed);
+    bool ascending   = std::is_sorted (typed_elems.begin (), typed_elems.end ());
+
+    list::dtor (&typed);
+
+    _ASSERT (product == 120);
+    _ASSERT (ascending);
+
+    TEST_END ();
+}
+
+// ----------------------------------------------------------------------------
+
+int test_for_each ()
+{
+    TEST_START ();
+
+    // Every element goes after a scattered cell, so storage order isn't logical
+    val = 0;
+    list::push_back (&list, &val);
+    for (val = 1; val < 100; ++val)
+    {
+        list::insert_after (&list, (size_t) (val * 7919 % 101 % val) + 1, &val);
+    }
+
+    std::vector<int> expected;
+    for (int elem : list::view<int> (&list))
+    {
+        expected.push_back (elem);
+    }
+
+    std::vector<int> seen;
+    list::for_each<int> (&list, [&seen] (int elem) { seen.push_back (elem); });
+    _ASSERT (seen == expected);
+
+    list::for_each<int> (&list, [] (int &elem) { elem = -elem; });
+
+    int sum = 0;
+    list::visit (&list, [] (void *elem, void *ctx) { *(int *) ctx += *(int *) elem; }, &sum);
+    _ASSERT (sum == -4950);
+
+    // Sorted list is swept linearly, order must stay the same
+    list::sort (&list);
+    seen.clear ();
+    const list::list_t *const_list = &list;
+    list::for_each<int> (const_list, [&seen] (int elem) { seen.push_back (-elem); });
+    _ASSERT (seen == expected);
+
+    list::typed_list<int, uint16_t> typed;
+    list::ctor (&typed, 0);
+    for (int i = 1; i <= 5; ++i)
+    {
+        list::push_front (&typed, i);
+    }
+
+    int order = 0;
+    list::for_each (&typed, [&order] (int elem) { order = order * 10 + elem; });
+
+    list::dtor (&typed);
+
+    _ASSERT (order == 54321);
+
+    TEST_END ();
+}
+
+// ----------------------------------------------------------------------------
+
+struct keyed_t
+{
+    int key;
+    int seq;
+};
+
+static int cmp_int (const void *a, const void *b)
+{
+    int lhs = *(const int *) a;
+    int rhs = *(const int *) b;
+
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+static int cmp_keyed (const void *a, const void *b)
+{
+    return cmp_int (&((const keyed_t *) a)->key, &((const keyed_t *) b)->key);
+}
+
+static uint64_t keyed_key (const void *elem)
+{
+    // Sign bit flipped, so negative keys go first
+    return (uint32_t) ((const keyed_t *) elem)->key ^ 0x80000000u;
+}
+
+static bool is_stable_order (list::list_t *list)
+{
+    for (auto it = list::view<keyed_t> (list).begin (); std::next (it).cell != 0; ++it)
+    {
+        const keyed_t &cur  = *it;
+        const keyed_t &next = *std::next (it);
+
+        if (cur.key > next.key || (cur.key == next.key && cur.seq > next.seq))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int test_sort_by ()
+{
+    TEST_START ();
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        val = i * 7919 % 1000;
+        list::push_front (&list, &val);
+    }
+
+    size_t head_cell = list::head (&list);
+    list::get (&list, head_cell, &val);
+    int head_val = val;
+
+    list::sort_by (&list, cmp_int);
+    auto elems = list::view<int> (&list);
+    _ASSERT (std::is_sorted (elems.begin (), elems.end ()));
+
+    // Payloads didn't move
+    list::get (&list, head_cell, &val);
+    _ASSERT (val == head_val);
+
+    val = -1;
+    list::push_back (&list, &val);
+    list::sort_by (&list, cmp_int, true);
+    _ASSERT (list.is_sorted && list::head (&list) == 1);
+    list::get (&list, 1, &val);
+    _ASSERT (val == -1);
+
+    list::list_t keyed;
+    list::ctor (&keyed, sizeof (keyed_t), 0, [] (void *, FILE *) {});
+    for (int i = 0; i < 3000; ++i)
+    {
+        keyed_t elem = {i % 7 - 3, i};
+        list::push_back (&keyed, &elem);
+    }
+
+    list::sort_by (&keyed, cmp_keyed);
+    bool merge_stable = is_stable_order (&keyed);
+
+    for (int i = 0; i < 3000; i += 2)
+    {
+        keyed_t elem = {(i * 31) % 1000 - 500, 3000 + i};
+        list::push_back (&keyed, &elem);
+    }
+
+    list::sort_by_key (&keyed, keyed_key);
+    bool radix_stable = is_stable_order (&keyed);
+    size_t keyed_size = keyed.size;
+
+    list::dtor (&keyed);
+
+    _ASSERT (merge_stable);
+    _ASSERT (radix_stable);
+    _ASSERT (keyed_size == 4500);
+
+    TEST_END ();
+}
+
+// ----------------------------------------------------------------------------
+
+int test_sort_parallel ()
+{
+    TEST_START ();
+
+    // Every element goes after a scattered cell, some cells are freed
+    val = 0;
+    list::push_back (&list, &val);
+    for (val = 1; val < 30000; ++val)
+    {
+        list::insert_after (&list, (size_t) (val * 7919 % 30011 % val) + 1, &val);
+    }
+    for (size_t cell = 5; cell < 30000; cell += 97)
+    {
+        list::remove (&list, cell, &val);
+    }
+
+    std::vector<int> expected;
+    for (int elem : list::view<int> (&list))
+    {
+        expected.push_back (elem);
+    }
+
+    _ASSERT (list::sort_parallel (&list, 4) == list::OK);
+    _ASSERT (list.is_sorted && list::head (&list) == 1);
+    _ASSERT (list::verify (&list) == 0);
+
+    std::vector<int> seen;
+    for (int elem : list::view<int> (&list))
+    {
+        seen.push_back (elem);
+    }
+    _ASSERT (seen == expected);
+
+    // Freed cells are reused in order after the rebuild
+    _ASSERT (list::push_back (&list, &val) == (ssize_t) expected.size () + 1);
+
+    TEST_END ();
+}
+
+// ----------------------------------------------------------------------------
+
+int test_local_alloc ()
+{
+    TEST_START ();
+
+    list::resize (&list, 32);
+    for (val = 0; val < 10; ++val)
+    {
+        list::push_back (&list, &val);
+    }
+
+    // FIFO use of a linear list: freed front cells must not be reused at the back
+    list::pop_front (&list, &val);
+    list::pop_front (&list, &val);
+    list::pop_front (&list, &val);
+
+    _ASSERT (list::push_back (&list, &val) == 11);
+    _ASSERT (list::push_front (&list, &val) == 3);
+    _ASSERT (list.is_sorted);
+    _ASSERT (list::get_iter (&list, 1) == 4);
+
+    // Hole in the middle: insert after its neighbour fills it
+    list::remove (&list, 6, &val);
+    _ASSERT (!list.is_sorted);
+    _ASSERT (list::insert_after (&list, 5, &val) == 6);
+
+    // No free cell near index: nearest one is taken, not the free head
+    _ASSERT (list::insert_after (&list, 8, &val) == 12);
+
+    // Free cells only far away: free head (last freed of 1, 2) is the fallback
+    for (val = 0; val < 20; ++val)
+    {
+        list::push_back (&list, &val);
+    }
+    _ASSERT (list::insert_after (&list, 20, &val) == 2);
+    _ASSERT (list::verify (&list) == 0);
+
+    TEST_END ();
+}
+
+// ----------------------------------------------------------------------------
+
+static bool is_negative (const void *elem, void *)
+{
+    return *(const int *) elem < 0;
+}
+
+int test_search ()
+{
+    TEST_START ();
+
+    for (val = 0; val < 1000; ++val)
+    {
+        list::push_front (&list, &val);
+    }
+
+    // Removed cell keeps its payload, search must skip it
+    val = 7;
+    list::remove (&list, (size_t) list::find (&list, &val), &val);
+
+    for (int i = 0; i < 1000; i += 10)
+    {
+        val = -i - 1;
+        list::push_back (&list, &val);
+    }
+
+    int seven     = 7;
+    int minus_11  = -11;
+    int five_hund = 500;
+    int answer    = 4242;
+
+    _ASSERT (list::find  (&list, &seven) == -1);
+    _ASSERT (list::count (&list, &seven) == 0);
+    _ASSERT (list::count (&list, &minus_11) == 1);
+    _ASSERT (list::count_if (&list, is_negative, nullptr) == 100);
+
+    ssize_t cell = list::find (&list, &five_hund);
+    _ASSERT (cell > 0);
+    list::get (&list, (size_t) cell, &val);
+    _ASSERT (val == 500);
+
+    for (int i = 0; i < 6; ++i)
+    {
+        list::push_back (&list, &answer);
+    }
+
+    size_t cells[8] = {};
+    _ASSERT (list::find_all (&list, &answer, cells, 2) == 6);
+    list::get (&list, cells[1], &val);
+    _ASSERT (val == 4242);
+
+    // Sorted list is scanned from the head only
+    list::sort (&list);
+    _ASSERT (list::find_all (&list, &answer, cells, 8) == 6);
+    _ASSERT (cells[0] < cells[1] && cells[5] == list::tail (&list));
+    _ASSERT (list::count_if (&list, is_negative, nullptr) == 100);
+
+    // Element size without vector kernel
+    struct rgb_t { char r, g, b; };
+    list::list_t colors;
+    list::ctor (&colors, sizeof (rgb_t), 0, [] (void *, FILE *) {});
+    for (char i = 0; i < 50; ++i)
+    {
+        rgb_t color = {i, (char) (i + 1), (char) (i + 2)};
+        list::push_front (&colors, &color);
+    }
+    rgb_t   wanted = {10, 11, 12};
+    ssize_t found  = list::find (&colors, &wanted);
+    list::dtor (&colors);
+
+    _ASSERT (found == 11);
+
+    TEST_END ();
+}
+
+// ----------------------------------------------------------------------------
+
+int test_dump_window ()
+{
+    TEST_START ();
+
+    for (val = 0; val < 1000; ++val)
+    {
+        list::push_back (&list, &val);
+    }
+
+    char text[4096] = "";
+    auto dump_text  = [&list, &text] (list::dump_window_t window)
+    {
+        FILE *stream = tmpfile ();
+        if (stream == nullptr)
+        {
+            text[0] = '\0';
+            return;
+        }
+
+        list::dump (&list, stream, &window);
+        rewind (stream);
+        text[fread (text, 1, sizeof (text) - 1, stream)] = '\0';
+        fclose (stream);
+    };
+
+    dump_text ({list::DUMP_CELLS, 500, 2});
+    _ASSERT (strstr (text, "shown:     6") != nullptr);
+    _ASSERT (strstr (text, "cells 1..497 skipped: 497 live, 0 free") != nullptr);
+    _ASSERT (strstr (text, "  499\n") != nullptr);
+
+    // Logical window on unsorted list follows links, not cell numbers
+    val = -1;
+    list::insert_after (&list, 0, &val);
+    _ASSERT (!list.is_sorted);
+
+    char head_row[64] = "";
+    snprintf (head_row, sizeof (head_row), "%8zu %8d %8zu  -1\n",
+              list::head (&list), 0, (size_t) 1);
+
+    dump_text ({list::DUMP_LOGICAL, 0, 0});
+    _ASSERT (strstr (text, "shown:     2") != nullptr);
+    _ASSERT (strstr (text, head_row) != nullptr);
+
+    // Broken window finds the cell with bad links
+    size_t        bad  = list::get_iter (&list, 10);
+    list::index_t next = list.next_arr[bad];
+    list.next_arr[bad] = 0;
+
+    dump_text ({list::DUMP_BROKEN, 0, 1});
+    list.next_arr[bad] = next;
+
+    _ASSERT (strstr (text, "<- broken") != nullptr);
+    _ASSERT (strstr (text, "skipped") != nullptr);
+
+    TEST_END ();
+}
+
+// ----------------------------------------------------------------------------
+
+int test_dump_pipeline ()
+{
+    TEST_START ();
+
+    FILE *main_stream = get_log_stream ();
+    FILE *stream      = tmpfile ();
+    _ASSERT (stream != nullptr);
+    set_log_stream (stream);
+
+    for (val = 0; val < 10; ++val)
+    {
+        list::push_back (&list, &val);
+    }
+
+    list::set_dump_workers (1);
+    list::set_dump_limits  (2, 0);
+    list::dump_stats_t before = list::graph_dump_stats ();
+
+    // Snapshot is taken at call time, later changes don't reach the dump
+    for (int i = 0; i < 50; ++i)
+    {
+        list::graph_dump (&list, "Pipeline %d", i);
+        list::pop_front (&list, &val);
+        list::push_back (&list, &val);
+    }
+    list::graph_dump_flush ();
+
+    list::dump_stats_t after = list::graph_dump_stats ();
+
+    // Synchronous mode renders every dump
+    list::set_dump_workers (0);
+    list::graph_dump (&list, "Sync");
+    list::dump_stats_t sync = list::graph_dump_stats ();
+
+    list::set_dump_workers (1);
+    list::set_dump_limits  (16, 0);
+    set_log_stream (main_stream);
+    fclose (stream);
+
+    _ASSERT (after.requested - before.requested == 50);
+    _ASSERT (after.rendered - before.rendered + after.dropped - before.dropped == 50);
+    _ASSERT (after.rendered > before.rendered);
+    _ASSERT (sync.rendered == after.rendered + 1 && sync.dropped == after.dropped);
+
+    TEST_END ();
+}
+
+// ----------------------------------------------------------------------------
+
+int test_concurrent_list ()
+{
+    TEST_START ();
+
+    const size_t THREADS = 4;
+    const size_t PER_THREAD = 5000;
+
+    list::conc_list_t conc;
+    _ASSERT (list::conc::ctor (&conc, sizeof (size_t)) == list::OK);
+
+    std::vector<std::thread> threads;
+    size_t popped_sum[THREADS] = {};
+    size_t popped_cnt[THREADS] = {};
+
+    for (size_t t = 0; t < THREADS; ++t)
+    {
+        threads.emplace_back ([&conc, &popped_sum, &popped_cnt, t, PER_THREAD]
+        {
+            for (size_t i = 1; i <= PER_THREAD; ++i)
+            {
+                size_t elem = t * PER_THREAD + i;
+                if (i % 2 == 0) list::conc::push_back  (&conc, &elem);
+                else            list::conc::push_front (&conc, &elem);
+
+                if (i % 3 == 0 && list::conc::pop_front (&conc, &elem) == list::OK)
+                {
+                    popped_sum[t] += elem;
+                    popped_cnt[t]++;
+                }
+            }
+        });
+    }
+
+    // Walker runs while cells are linked, unlinked and chunks are added
+    std::thread walker ([&conc]
+    {
+        for (size_t pass = 0; pass < 50; ++pass)
+        {
+            size_t steps = 0;
+            for (size_t i = list::conc::head (&conc); i != 0 && steps < 100000;
+                 i = list::conc::next (&conc, i), steps++) {}
+        }
+    });
+
+    for (size_t t = 0; t < THREADS; ++t)
+    {
+        threads[t].join ();
+    }
+    walker.join ();
+
+    _ASSERT (list::conc::verify (&conc) == list::OK);
+
+    size_t total = THREADS * PER_THREAD;
+    size_t sum   = 0;
+    size_t cnt   = 0;
+    for (size_t t = 0; t < THREADS; ++t)
+    {
+        sum += popped_sum[t];
+        cnt += popped_cnt[t];
+    }
+
+    _ASSERT (conc.size.load () == total - cnt);
+
+    size_t elem = 0;
+    while (list::conc::pop_back (&conc, &elem) == list::OK)
+    {
+        sum += elem;
+    }
+
+    _ASSERT (sum == total * (total + 1) / 2);
+    _ASSERT (list::conc::verify (&conc) == list::OK);
+
+    list::conc::dtor (&conc);
+
+    TEST_END ();
+}
+
+// ----------------------------------------------------------------------------
+
+int test_concurrent_remove ()
+{
+    TEST_START ();
+
+    const size_t THREADS = 4;
+    const size_t STRIPES = THREADS + 1;
+    const size_t COUNT   = 20000;
+    const size_t ROUNDS  = 100;
+
+    bool ok = true;
+
+    // Thread t removes every STRIPES-th cell starting at t, so neighbours
+    // go away at the same time; the last stripe stays
+    for (size_t round = 0; round < ROUNDS && ok; ++round)
+    {
+        list::conc_list_t conc;
+        list::conc::ctor (&conc, sizeof (size_t));
+
+        std::vector<size_t> cells (COUNT);
+        for (size_t i = 0; i < COUNT; ++i)
+        {
+            cells[i] = (size_t) list::conc::push_back (&conc, &i);
+        }
+
+        std::vector<std::thread> threads;
+        size_t removed[THREADS] = {};
+
+        for (size_t t = 0; t < THREADS; ++t)
+        {
+            threads.emplace_back ([&conc, &cells, &removed, t, STRIPES, COUNT]
+            {
+                for (size_t i = t; i < COUNT; i += STRIPES)
+                {
+                    removed[t] += list::conc::remove (&conc, cells[i], nullptr) == list::OK;
+                }
+            });
+        }
+
+        for (std::thread &thread : threads)
+        {
+            thread.join ();
+        }
+
+        size_t expected = THREADS;
+        for (size_t i = list::conc::head (&conc); i != 0; i = list::conc::next (&conc, i))
+        {
+            size_t elem = 0;
+            list::conc::get (&conc, i, &elem);
+            ok = ok && elem == expected;
+            expected += STRIPES;
+        }
+
+        for (size_t t = 0; t < THREADS; ++t)
+        {
+            ok = ok && removed[t] == COUNT / STRIPES;
+        }
+
+        ok = ok && expected == COUNT + THREADS && list::conc::verify (&conc) == list::OK;
+
+        list::conc::dtor (&conc);
+    }
+
+    _ASSERT (ok);
+
+    TEST_END ();
+}
+
+// ----------------------------------------------------------------------------
+
+int test_queue_spsc ()
+{
+    TEST_START ();
+
+    const int COUNT = 100000;
+
+    list::resize (&list, 100);
+    for (val = 0; val < 3; ++val)
+    {
+        list::push_front (&list, &val);
+    }
+
+    list::queue_t queue;
+    _ASSERT (list::queue::attach (&queue, &list, list::QUEUE_SPSC) == list::OK);
+    _ASSERT (list::queue::size (&queue) == 3);
+
+    // Existing elements come first, in list order
+    _ASSERT (list::queue::pop (&queue, &val) && val == 2);
+    _ASSERT (list::queue::pop (&queue, &val) && val == 1);
+    _ASSERT (list::queue::pop (&queue, &val) && val == 0);
+
+    std::thread producer ([&queue, COUNT]
+    {
+        int batch[16] = {};
+        for (int i = 0; i < COUNT; )
+        {
+            int n = (COUNT - i < 16) ? COUNT - i : 16;
+            for (int j = 0; j < n; ++j)
+            {
+                batch[j] = i + j;
+            }
+
+            size_t pushed = list::queue::push_n (&queue, batch, (size_t) n);
+            if (pushed == 0)
+            {
+                std::this_thread::yield ();
+            }
+            i += (int) pushed;
+        }
+    });
+
+    int  batch[32] = {};
+    int  expected  = 0;
+    bool in_order  = true;
+    while (expected < COUNT)
+    {
+        size_t n = list::queue::pop_n (&queue, batch, 32);
+        if (n == 0)
+        {
+            std::this_thread::yield ();
+        }
+        for (size_t j = 0; j < n; ++j)
+        {
+            in_order &= batch[j] == expected++;
+        }
+    }
+    producer.join ();
+
+    _ASSERT (in_order);
+    _ASSERT (!list::queue::pop (&queue, &val));
+
+    for (val = 0; val < 150; ++val)
+    {
+        list::queue::push (&queue, &val);
+    }
+    _ASSERT (list::queue::size (&queue) == 100);
+
+    list::queue::pop_n (&queue, batch, 30);
+    list::queue::detach (&queue);
+
+    _ASSERT (list.size == 70);
+    _ASSERT (list::verify (&list) == list::OK);
+    list::get (&list, list::head (&list), &val);
+    _ASSERT (val == 30);
+    list::get (&list, list::tail (&list), &val);
+    _ASSERT (val == 99);
+
+    TEST_END ();
+}
+
+int test_queue_mpsc ()
+{
+    TEST_START ();
+
+    const size_t PRODUCERS    = 3;
+    const size_t PER_PRODUCER = 30000;
+
+    list::resize (&list, 64);
+
+    list::queue_t queue;
+    _ASSERT (list::queue::attach (&queue, &list, list::QUEUE_MPSC) == list::OK);
+
+    std::vector<std::thread> producers;
+    for (size_t p = 0; p < PRODUCERS; ++p)
+    {
+        producers.emplace_back ([&queue, p, PER_PRODUCER]
+        {
+            for (size_t i = 0; i < PER_PRODUCER; )
+            {
+                int elem = (int) (p * PER_PRODUCER + i);
+                if (list::queue::push (&queue, &elem))
+                {
+                    i++;
+                }
+                else
+                {
+                    std::this_thread::yield ();
+                }
+            }
+        });
+    }
+
+    // Per producer order is kept
+    size_t last[PRODUCERS] = {};
+    size_t received = 0;
+    bool   in_order = true;
+    int    batch[8] = {};
+    while (received < PRODUCERS * PER_PRODUCER)
+    {
+        size_t n = list::queue::pop_n (&queue, batch, 8);
+        if (n == 0)
+        {
+            std::this_thread::yield ();
+        }
+        for (size_t j = 0; j < n; ++j)
+        {
+            size_t p = (size_t) batch[j] / PER_PRODUCER;
+            size_t i = (size_t) batch[j] % PER_PRODUCER + 1;
+
+            in_order &= i > last[p];
+            last[p]   = i;
+        }
+        received += n;
+    }
+
+    for (size_t p = 0; p < PRODUCERS; ++p)
+    {
+        producers[p].join ();
+        in_order &= last[p] == PER_PRODUCER;
+    }
+
+    _ASSERT (in_order);
+    _ASSERT (list::queue::size (&queue) == 0);
+
+    list::queue::detach (&queue);
+    _ASSERT (list::verify (&list) == list::OK);
+    _ASSERT (list.size == 0);
+
+    TEST_END ();
+}
+
+// ----------------------------------------------------------------------------
+
+#define TYPED_TEST_START(index_t)                       \
+    list::typed_list<int, index_t> list;                \
+    list::ctor (&list, 0);                              \
+    [[maybe_unused]] int val = 0;
+
+int test_typed_push_pop ()
+{
+    TYPED_TEST_START (size_t);
+
+    list::push_back  (&list, 1);
+    list::push_back  (&list, 2);
+    list::push_front (&list, 0);
+
+    _ASSERT (list::verify (&list) == list::OK);
     _ASSERT (list.is_sorted == false);
 
+    list::get (&list, list::get_iter (&list, 2), &val);
+    _ASSERT (val == 2);
+
+    list::pop_front (&list, &val);
+    _ASSERT (val == 0);
+    list::pop_back  (&list, &val);
+    _ASSERT (val == 2);
+    list::pop_back  (&list, &val);
+    _ASSERT (val == 1);
+    _ASSERT (list.size == 0);
+
+    TEST_END ();
+}
+
+int test_typed_sort ()
+{
+    TYPED_TEST_START (uint16_t);
+
+    for (int i = 0; i < 100; ++i)
+    {
+        list::push_front (&list, i);
+    }
+
+    list::sort (&list);
+
+    _ASSERT (list::verify (&list) == list::OK);
+    _ASSERT (list.is_sorted == true);
+
+    list::get (&list, list::get_iter (&list, 0), &val);
+    _ASSERT (val == 99);
+    list::get (&list, list::get_iter (&list, 99), &val);
+    _ASSERT (val == 0);
+
+    TEST_END ();
+}
+
+int test_typed_index_overflow ()
+{
+    TYPED_TEST_START (uint8_t);
+
+    for (int i = 0; i < 254; ++i)
+    {
+        _ASSERT (list::push_back (&list, i) > 0);
+    }
+
+    _ASSERT (list::push_back (&list, 0) == -1);
+    _ASSERT (list::verify (&list) == list::OK);
+
     TEST_END ();
 }
+
 // ----------------------------------------------------------------------------
 
 void run_tests ()
@@ -218,6 +2026,43 @@ void run_tests ()
     _TEST (test_sorted_pop_push_front ());
     _TEST (test_sorted_pop_push_back ());
     _TEST (test_sorted_with_shift ());
+    _TEST (test_order_index ());
+    _TEST (test_compact_step ());
+    _TEST (test_compact_budget ());
+    _TEST (test_sort_in_place ());
+    _TEST (test_capacity_overflow ());
+    _TEST (test_verify_local ());
+    _TEST (test_push_back_n ());
+    _TEST (test_splice_same_list ());
+    _TEST (test_splice_concat ());
+    _TEST (test_shrink_to_fit ());
+    _TEST (test_shrink_free_chain ());
+    _TEST (test_auto_shrink ());
+    _TEST (test_arena_allocator ());
+    _TEST (test_mmap_allocator ());
+    _TEST (test_append_fallback ());
+    _TEST (test_splice_oom ());
+    _TEST (test_resize_rollback ());
+    _TEST (test_allocator_owns_all ());
+    _TEST (test_mapped_roundtrip ());
+    _TEST (test_save_load ());
+    _TEST (test_stats ());
+    _TEST (test_async_log ());
+    _TEST (test_iterators ());
+    _TEST (test_for_each ());
+    _TEST (test_search ());
+    _TEST (test_sort_by ());
+    _TEST (test_sort_parallel ());
+    _TEST (test_local_alloc ());
+    _TEST (test_dump_window ());
+    _TEST (test_dump_pipeline ());
+    _TEST (test_concurrent_list ());
+    _TEST (test_concurrent_remove ());
+    _TEST (test_queue_spsc ());
+    _TEST (test_queue_mpsc ());
+    _TEST (test_typed_push_pop ());
+    _TEST (test_typed_sort ());
+    _TEST (test_typed_index_overflow ());
 
 
     log (log::INF, "Tests total: %u, failed %u, success: %u, success ratio: %3.1lf%%",
@@ -13,6 +13,45 @@ int test_sorted_pop_push_front ();
 int test_sorted_with_shift ();
 int test_sorted_pop_push_back ();
 
+int test_order_index ();
+int test_compact_step ();
+int test_compact_budget ();
+int test_sort_in_place ();
+int test_capacity_overflow ();
+int test_verify_local ();
+int test_push_back_n ();
+int test_splice_same_list ();
+int test_splice_concat ();
+int test_shrink_to_fit ();
+int test_shrink_free_chain ();
+int test_auto_shrink ();
+int test_arena_allocator ();
+int test_mmap_allocator ();
+int test_append_fallback ();
+int test_splice_oom ();
+int test_resize_rollback ();
+int test_allocator_owns_all ();
+int test_mapped_roundtrip ();
+int test_save_load ();
+int test_stats ();
+int test_async_log ();
+int test_iterators ();
+int test_for_each ();
+int test_search ();
+int test_sort_by ();
+int test_sort_parallel ();
+int test_local_alloc ();
+int test_dump_window ();
+int test_dump_pipeline ();
+int test_concurrent_list ();
+int test_concurrent_remove ();
+int test_queue_spsc ();
+int test_queue_mpsc ();
+
+int test_typed_push_pop ();
+int test_typed_sort ();
+int test_typed_index_overflow ();
+
 void run_tests ();
 
 #endif //TEST_H
\ No newline at end of file
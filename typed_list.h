@@ -0,0 +1,656 @@
+#ifndef TYPED_LIST_H
+#define TYPED_LIST_H
+
+#include <assert.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <concepts>
+#include <limits>
+#include <type_traits>
+
+#include "include/common.h"
+#include "lib/log.h"
+#include "list.h"
+
+// ----------------------------------------------------------------------------
+// Header-only typed front-end over the same index-linked layout as list_t.
+// Element size is known at compile time, so copies are plain loads/stores
+// instead of memcpy (..., obj_size).
+// ----------------------------------------------------------------------------
+
+namespace list
+{
+    template <typename T>
+    concept list_elem = std::is_trivially_copyable_v<T>;
+
+    template <typename IndexT>
+    concept list_index = std::unsigned_integral<IndexT> && !std::same_as<IndexT, bool>;
+
+    template <list_elem T, list_index IndexT = size_t>
+    struct typed_list
+    {
+        typedef T      value_type;
+        typedef IndexT index_type;
+
+        static constexpr IndexT FREE_PREV    = std::numeric_limits<IndexT>::max ();
+        static constexpr size_t MAX_CAPACITY = (size_t) std::numeric_limits<IndexT>::max () - 1;
+
+        T      *data_arr;
+        IndexT *prev_arr;
+        IndexT *next_arr;
+
+        IndexT free_head;
+        IndexT free_back;
+
+        size_t reserved;
+        size_t capacity;
+        size_t size;
+
+        bool is_sorted;
+
+        void (*print_func)(const T *elem, FILE *stream);
+    };
+
+    template <typename T, typename IndexT>
+    err_flags verify (const typed_list<T, IndexT> *list);
+
+    template <typename T, typename IndexT>
+    err_flags verify_local (const typed_list<T, IndexT> *list, size_t index);
+
+    template <typename T, typename IndexT>
+    err_t resize (typed_list<T, IndexT> *list, size_t new_capacity);
+
+    template <typename T, typename IndexT>
+    void dump (const typed_list<T, IndexT> *list, FILE *stream = stdout);
+
+    namespace detail
+    {
+        template <typename T, typename IndexT>
+        ssize_t get_free_cell (typed_list<T, IndexT> *list);
+
+        template <typename T, typename IndexT>
+        void release_free_cell (typed_list<T, IndexT> *list, size_t index);
+
+        template <typename T, typename IndexT>
+        bool check_index (const typed_list<T, IndexT> *list, size_t index, bool can_be_zero);
+
+        template <typename T, typename IndexT>
+        void init_free_cells (typed_list<T, IndexT> *list, size_t from, size_t to);
+    }
+
+    // ------------------------------------------------------------------------
+
+    template <typename T, typename IndexT>
+    err_t ctor (typed_list<T, IndexT> *list, size_t reserved,
+                void (*print_func)(const T *elem, FILE *stream) = nullptr)
+    {
+        assert (list != nullptr && "pointer can't be nullptr");
+
+        list->data_arr = nullptr;
+        list->prev_arr = nullptr;
+        list->next_arr = nullptr;
+
+        if (reserved > typed_list<T, IndexT>::MAX_CAPACITY)
+        {
+            log (log::ERR, "Reserved %zu cells, index type allows only %zu",
+                            reserved, typed_list<T, IndexT>::MAX_CAPACITY);
+            return list::CAPACITY_OVERFLOW;
+        }
+
+        // Allocate null object + reserved
+        list->data_arr = (T *)      calloc (reserved + 1, sizeof (T));
+        list->prev_arr = (IndexT *) calloc (reserved + 1, sizeof (IndexT));
+        list->next_arr = (IndexT *) calloc (reserved + 1, sizeof (IndexT));
+
+        if (list->data_arr == nullptr || list->prev_arr == nullptr || list->next_arr == nullptr)
+        {
+            free (list->data_arr);
+            free (list->prev_arr);
+            free (list->next_arr);
+            return list::OOM;
+        }
+
+        list->reserved   = reserved;
+        list->capacity   = reserved;
+        list->size       = 0;
+        list->is_sorted  = true;
+        list->print_func = print_func;
+
+        list->prev_arr[0] = 0;
+        list->next_arr[0] = 0;
+        list->free_head   = 0;
+        list->free_back   = 0;
+
+        detail::init_free_cells (list, 1, reserved);
+
+        return list::OK;
+    }
+
+    template <typename T, typename IndexT>
+    void dtor (typed_list<T, IndexT> *list)
+    {
+        assert (list != nullptr && "pointer can't be null");
+
+        free (list->data_arr);
+        free (list->prev_arr);
+        free (list->next_arr);
+    }
+
+    // ------------------------------------------------------------------------
+
+    template <typename T, typename IndexT>
+    [[nodiscard]]
+    err_flags verify (const typed_list<T, IndexT> *list)
+    {
+        if (list == nullptr)
+        {
+            return list::NULLPTR;
+        }
+
+        err_flags flags = list::OK;
+
+        if (list->capacity < list->reserved || list->capacity > typed_list<T, IndexT>::MAX_CAPACITY)
+        {
+            flags |= list::INVALID_CAPACITY;
+        }
+
+        if (list->size > list->capacity)
+        {
+            flags |= list::INVALID_SIZE;
+        }
+
+        if (flags != list::OK)
+        {
+            return flags;
+        }
+
+        // Data loop
+        size_t index = 0;
+        for (size_t i = 0; i < list->size; ++i)
+        {
+            size_t next = list->next_arr[index];
+
+            if (!detail::check_index (list, next, false) || list->prev_arr[next] != index)
+            {
+                flags |= list::BROKEN_DATA_LOOP;
+                break;
+            }
+
+            index = next;
+        }
+
+        if (flags == list::OK && (list->next_arr[index] != 0 || list->prev_arr[0] != index))
+        {
+            flags |= list::BROKEN_DATA_LOOP;
+        }
+
+        // Free loop
+        index = list->free_head;
+        for (size_t i = 0; i < list->capacity - list->size; ++i)
+        {
+            if (index == 0 || index > list->capacity ||
+                list->prev_arr[index] != typed_list<T, IndexT>::FREE_PREV)
+            {
+                flags |= list::BROKEN_FREE_LOOP;
+                return flags;
+            }
+
+            index = list->next_arr[index];
+        }
+
+        if (index != 0)
+        {
+            flags |= list::BROKEN_FREE_LOOP;
+        }
+
+        return flags;
+    }
+
+    template <typename T, typename IndexT>
+    [[nodiscard]]
+    err_flags verify_local (const typed_list<T, IndexT> *list, size_t index)
+    {
+        if (list == nullptr)
+        {
+            return list::NULLPTR;
+        }
+
+        if (list->capacity < list->reserved || list->capacity > typed_list<T, IndexT>::MAX_CAPACITY)
+        {
+            return list::INVALID_CAPACITY;
+        }
+
+        if (list->size > list->capacity)
+        {
+            return list::INVALID_SIZE;
+        }
+
+        if (index > list->capacity)
+        {
+            return list::BROKEN_DATA_LOOP;
+        }
+
+        size_t cells[2] = {0, index};
+
+        for (size_t cell : cells)
+        {
+            if (list->prev_arr[cell] == typed_list<T, IndexT>::FREE_PREV)
+            {
+                continue;
+            }
+
+            size_t next = list->next_arr[cell];
+            size_t prev = list->prev_arr[cell];
+
+            if (next > list->capacity || prev > list->capacity ||
+                list->next_arr[prev] != cell || list->prev_arr[next] != cell)
+            {
+                return list::BROKEN_DATA_LOOP;
+            }
+        }
+
+        return list::OK;
+    }
+
+    // ------------------------------------------------------------------------
+
+    template <typename T, typename IndexT>
+    ssize_t insert_after (typed_list<T, IndexT> *list, size_t index, const T &elem)
+    {
+        assert (list != nullptr && "pointer can't be nullptr");
+        list_assert (list);
+        assert (detail::check_index (list, index, true) && "invalid index");
+
+        ssize_t free_index_tmp = detail::get_free_cell (list);
+        if (free_index_tmp == -1) return -1;
+
+        IndexT free_index = (IndexT) free_index_tmp;
+
+        if (free_index != index + 1)
+        {
+            list->is_sorted = false;
+        }
+
+        list->data_arr[free_index] = elem;
+
+        list->prev_arr[list->next_arr[index]] = free_index;
+        list->next_arr[free_index] = list->next_arr[index];
+        list->prev_arr[free_index] = (IndexT) index;
+        list->next_arr[index]      = free_index;
+
+        return (ssize_t) free_index;
+    }
+
+    template <typename T, typename IndexT>
+    ssize_t insert_before (typed_list<T, IndexT> *list, size_t index, const T &elem)
+    {
+        assert (list != nullptr && "pointer can't be nullptr");
+        assert (detail::check_index (list, index, true) && "invalid index");
+
+        return list::insert_after (list, list->prev_arr[index], elem);
+    }
+
+    template <typename T, typename IndexT>
+    ssize_t push_back (typed_list<T, IndexT> *list, const T &elem)
+    {
+        assert (list != nullptr && "pointer can't be null");
+
+        return list::insert_after (list, list->prev_arr[0], elem);
+    }
+
+    template <typename T, typename IndexT>
+    ssize_t push_front (typed_list<T, IndexT> *list, const T &elem)
+    {
+        assert (list != nullptr && "pointer can't be null");
+
+        return list::insert_after (list, 0, elem);
+    }
+
+    // ------------------------------------------------------------------------
+
+    template <typename T, typename IndexT>
+    void get (const typed_list<T, IndexT> *list, size_t index, T *elem)
+    {
+        assert (list != nullptr && "pointer can't be nullptr");
+        assert (elem != nullptr && "pointer can't be nullptr");
+        assert (detail::check_index (list, index, false) && "invalid index");
+
+        *elem = list->data_arr[index];
+    }
+
+    template <typename T, typename IndexT>
+    void remove (typed_list<T, IndexT> *list, size_t index, T *elem)
+    {
+        assert (list != nullptr && "pointer can't be nullptr");
+        assert (elem != nullptr && "pointer can't be nullptr");
+        list_assert (list);
+        assert (detail::check_index (list, index, false) && "invalid index");
+
+        if (list->prev_arr[index] != 0 && list->next_arr[index] != 0)
+        {
+            list->is_sorted = false;
+        }
+
+        *elem = list->data_arr[index];
+        list->next_arr[list->prev_arr[index]] = list->next_arr[index];
+        list->prev_arr[list->next_arr[index]] = list->prev_arr[index];
+        detail::release_free_cell (list, index);
+    }
+
+    template <typename T, typename IndexT>
+    void pop_front (typed_list<T, IndexT> *list, T *elem)
+    {
+        assert (list != nullptr && "pointer can't be nullptr");
+
+        list::remove (list, list->next_arr[0], elem);
+    }
+
+    template <typename T, typename IndexT>
+    void pop_back (typed_list<T, IndexT> *list, T *elem)
+    {
+        assert (list != nullptr && "pointer can't be nullptr");
+
+        list::remove (list, list->prev_arr[0], elem);
+    }
+
+    // ------------------------------------------------------------------------
+
+    template <typename T, typename IndexT>
+    size_t next (const typed_list<T, IndexT> *list, size_t index)
+    {
+        assert (list != nullptr && "pointer can't be nullptr");
+        assert (detail::check_index (list, index, true) && "invalid index");
+
+        return list->next_arr[index];
+    }
+
+    template <typename T, typename IndexT>
+    size_t prev (const typed_list<T, IndexT> *list, size_t index)
+    {
+        assert (list != nullptr && "pointer can't be nullptr");
+        assert (detail::check_index (list, index, true) && "invalid index");
+
+        return list->prev_arr[index];
+    }
+
+    template <typename T, typename IndexT>
+    size_t head (const typed_list<T, IndexT> *list)
+    {
+        assert (list != nullptr && "pointer can't be nullptr");
+
+        return list->next_arr[0];
+    }
+
+    template <typename T, typename IndexT>
+    size_t tail (const typed_list<T, IndexT> *list)
+    {
+        assert (list != nullptr && "pointer can't be nullptr");
+
+        return list->prev_arr[0];
+    }
+
+    template <typename T, typename IndexT>
+    size_t get_iter (const typed_list<T, IndexT> *list, size_t index)
+    {
+        assert (list != nullptr && "pointer can't be null");
+        assert (index < list->size && "index out of bounds");
+
+        if (list->is_sorted)
+        {
+            return list->next_arr[0] + index;
+        }
+
+        size_t iter = list->next_arr[0];
+        for (size_t i = 0; i < index; ++i)
+        {
+            iter = list->next_arr[iter];
+        }
+
+        return iter;
+    }
+
+    // ------------------------------------------------------------------------
+
+    template <typename T, typename IndexT>
+    err_t resize (typed_list<T, IndexT> *list, size_t new_capacity)
+    {
+        assert (list != nullptr && "pointer can't be nullptr");
+        list_assert (list);
+        assert (new_capacity > list->capacity && "current implementation can't shrink");
+
+        if (new_capacity > typed_list<T, IndexT>::MAX_CAPACITY)
+        {
+            log (log::ERR, "Capacity %zu doesn't fit into index type (max %zu)",
+                            new_capacity, typed_list<T, IndexT>::MAX_CAPACITY);
+            return list::CAPACITY_OVERFLOW;
+        }
+
+        T      *new_data = (T *)      realloc (list->data_arr, (new_capacity + 1) * sizeof (T));
+        if (new_data == nullptr) { return list::OOM; }
+        list->data_arr = new_data;
+
+        IndexT *new_next = (IndexT *) realloc (list->next_arr, (new_capacity + 1) * sizeof (IndexT));
+        if (new_next == nullptr) { return list::OOM; }
+        list->next_arr = new_next;
+
+        IndexT *new_prev = (IndexT *) realloc (list->prev_arr, (new_capacity + 1) * sizeof (IndexT));
+        if (new_prev == nullptr) { return list::OOM; }
+        list->prev_arr = new_prev;
+
+        size_t old_capacity = list->capacity;
+        list->capacity = new_capacity;
+        detail::init_free_cells (list, old_capacity + 1, new_capacity);
+
+        return list::OK;
+    }
+
+    template <typename T, typename IndexT>
+    err_t sort (typed_list<T, IndexT> *list)
+    {
+        assert (list != nullptr && "pointer can't be nullptr");
+        list_assert (list);
+
+        T *new_data = (T *) calloc (list->capacity + 1, sizeof (T));
+        if (new_data == nullptr) { return list::OOM; }
+
+        size_t index = 0;
+        for (size_t i = 1; i <= list->size; ++i)
+        {
+            index = list->next_arr[index];
+            new_data[i] = list->data_arr[index];
+        }
+
+        for (size_t i = 1; i <= list->size; ++i)
+        {
+            list->next_arr[i] = (IndexT) (i + 1);
+            list->prev_arr[i] = (IndexT) (i - 1);
+        }
+
+        list->prev_arr[0] = (IndexT) list->size;
+        list->next_arr[0] = (list->size > 0) ? 1 : 0;
+        list->next_arr[list->size] = 0;
+
+        list->free_head = 0;
+        list->free_back = 0;
+        detail::init_free_cells (list, list->size + 1, list->capacity);
+
+        free (list->data_arr);
+        list->data_arr  = new_data;
+        list->is_sorted = true;
+
+        return list::OK;
+    }
+
+    // ------------------------------------------------------------------------
+
+    template <typename T, typename IndexT>
+    void dump (const typed_list<T, IndexT> *list, FILE *stream)
+    {
+        assert (list   != nullptr && "pointer can't be nullptr");
+        assert (stream != nullptr && "pointer can't be nullptr");
+
+        fprintf (stream, "Typed list dump:\n");
+
+        fprintf (stream, "\tfree_head: %zu\n", (size_t) list->free_head);
+        fprintf (stream, "\tobj_size:  %zu\n", sizeof (T));
+        fprintf (stream, "\tidx_size:  %zu\n", sizeof (IndexT));
+        fprintf (stream, "\treserved:  %zu\n", list->reserved);
+        fprintf (stream, "\tcapacity:  %zu\n", list->capacity);
+        fprintf (stream, "\tsize:      %zu\n", list->size);
+
+        for (size_t i = 0; i <= list->capacity; ++i)
+        {
+            fprintf (stream, "%3zu: ", i);
+
+            if (list->prev_arr[i] == typed_list<T, IndexT>::FREE_PREV)
+            {
+                fprintf (stream, "FREE");
+            }
+            else
+            {
+                if (i != 0 && list->print_func != nullptr)
+                {
+                    list->print_func (list->data_arr + i, stream);
+                }
+                fprintf (stream, " p: %zu", (size_t) list->prev_arr[i]);
+            }
+
+            fprintf (stream, " n: %zu\n", (size_t) list->next_arr[i]);
+        }
+    }
+
+    // Typed lists have no graphviz backend, so the dump goes to the log as text
+    template <typename T, typename IndexT>
+    void graph_dump (const typed_list<T, IndexT> *list, const char *reason_fmt, ...)
+    {
+        assert (list != nullptr && "pointer can't be nullptr");
+
+        va_list args;
+        va_start (args, reason_fmt);
+
+        #if HTML_LOGS
+            fprintf  (get_log_stream(), "<h2>List dump: ");
+            vfprintf (get_log_stream(), reason_fmt, args);
+            fprintf  (get_log_stream(), "</h2>\n");
+        #else
+            vfprintf (get_log_stream(), reason_fmt, args);
+            fputc    ('\n', get_log_stream());
+        #endif
+
+        va_end (args);
+
+        list::dump (list, get_log_stream ());
+        fflush (get_log_stream ());
+    }
+
+    // ------------------------------------------------------------------------
+    // INTERNALS
+    // ------------------------------------------------------------------------
+
+    namespace detail
+    {
+        template <typename T, typename IndexT>
+        void init_free_cells (typed_list<T, IndexT> *list, size_t from, size_t to)
+        {
+            assert (list != nullptr && "pointer can't be nullptr");
+
+            if (from > to)
+            {
+                return;
+            }
+
+            for (size_t i = from; i <= to; ++i)
+            {
+                list->next_arr[i] = (IndexT) (i + 1);
+                list->prev_arr[i] = typed_list<T, IndexT>::FREE_PREV;
+            }
+            list->next_arr[to] = 0;
+
+            if (list->free_back != 0)
+            {
+                list->next_arr[list->free_back] = (IndexT) from;
+            }
+            else
+            {
+                list->free_head = (IndexT) from;
+            }
+
+            list->free_back = (IndexT) to;
+        }
+
+        template <typename T, typename IndexT>
+        ssize_t get_free_cell (typed_list<T, IndexT> *list)
+        {
+            assert (list != nullptr && "pointer can't be nullptr");
+
+            if (list->free_head == 0)
+            {
+                size_t new_capacity = (list->capacity == 0) ? 1 : list->capacity * 2;
+                if (new_capacity > typed_list<T, IndexT>::MAX_CAPACITY)
+                {
+                    new_capacity = typed_list<T, IndexT>::MAX_CAPACITY;
+                }
+
+                if (new_capacity <= list->capacity)
+                {
+                    log (log::ERR, "Typed list is full: index type allows only %zu cells",
+                                    typed_list<T, IndexT>::MAX_CAPACITY);
+                    return ERROR;
+                }
+
+                err_t res = list::resize (list, new_capacity);
+                if (res != list::OK)
+                {
+                    log (log::ERR, "Failed to reallocate with error '%s'", list::err_to_str (res));
+                    return ERROR;
+                }
+            }
+
+            size_t free_index = list->free_head;
+
+            list->free_head = list->next_arr[free_index];
+            if (list->free_head == 0)
+            {
+                list->free_back = 0;
+            }
+
+            list->size++;
+
+            return (ssize_t) free_index;
+        }
+
+        template <typename T, typename IndexT>
+        void release_free_cell (typed_list<T, IndexT> *list, size_t index)
+        {
+            assert (list != nullptr && "pointer can't be nullptr");
+
+            list->next_arr[index] = list->free_head;
+            list->prev_arr[index] = typed_list<T, IndexT>::FREE_PREV;
+            list->free_head       = (IndexT) index;
+
+            if (list->free_back == 0)
+            {
+                list->free_back = (IndexT) index;
+            }
+
+            list->size--;
+        }
+
+        template <typename T, typename IndexT>
+        bool check_index (const typed_list<T, IndexT> *list, size_t index, bool can_be_zero)
+        {
+            assert (list != nullptr && "pointer can't be nullptr");
+
+            if (!can_be_zero && index == 0)                             return false;
+            if (index > list->capacity)                                 return false;
+            if (list->prev_arr[index] == typed_list<T, IndexT>::FREE_PREV) return false;
+
+            return true;
+        }
+    }
+}
+
+#endif //TYPED_LIST_H